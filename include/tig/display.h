@@ -57,6 +57,7 @@ void open_editor(const char *file, unsigned int lineno);
 void enable_mouse(bool enable);
 
 enum status_code open_script(const char *path);
+bool is_script_executing(void);
 
 #define get_cursor_pos(cursor_y, cursor_x) getyx(newscr, cursor_y, cursor_x)
 #define set_cursor_pos(cursor_y, cursor_x) wmove(newscr, cursor_y, cursor_x)
@@ -30,7 +30,6 @@ struct buffer {
 struct encoding;
 
 struct encoding *encoding_open(const char *fromcode);
-bool encoding_convert(struct encoding *encoding, struct buffer *buf);
 const char *encoding_iconv(iconv_t iconv_out, const char *string, size_t length);
 struct encoding *get_path_encoding(const char *path, struct encoding *default_encoding);
 
@@ -61,6 +60,10 @@ enum io_type {
 	IO_AP,			/* Append fork+exec output to file. */
 };
 
+struct io_batch;
+struct io_merge;
+struct io_trace;
+
 struct io {
 	int pipe;		/* Pipe end for reading or writing. */
 	pid_t pid;		/* PID of spawned process. */
@@ -71,6 +74,14 @@ struct io {
 	char *bufpos;		/* Current buffer position. */
 	unsigned int eof:1;	/* Has end of file been reached. */
 	int status:8;		/* Status exit code. */
+	struct io_merge *merge;	/* Merged output of several commands. */
+	struct io_batch *batch;	/* Batch process the content is read from. */
+	size_t batch_left;	/* Bytes left of the batch reply. */
+	struct encoding *encoding; /* Encoding to convert input from. */
+	char *raw;		/* Input not yet converted. */
+	size_t rawalloc;	/* Allocated raw buffer size. */
+	size_t rawsize;		/* Raw buffer content size. */
+	struct io_trace *trace;	/* Command timings, if tracing. */
 };
 
 typedef enum status_code (*io_read_fn)(char *, size_t, char *, size_t, void *data);
@@ -101,11 +112,20 @@ enum status_code io_load_span(struct io *io, const char *separators,
 enum status_code io_run_load(const char **argv, const char *separators,
 		io_read_fn read_property, void *data);
 char *io_memchr(struct buffer *buf, char *data, int c);
+bool io_object_sizes_request(const char *ids[], size_t count);
+ssize_t io_object_sizes_read(unsigned long sizes[], bool found[], size_t count, bool can_block);
+struct io *io_object_sizes_pipe(void);
+bool io_merge(struct io *io, struct io inputs[], size_t inputs_count, const char *record_end);
+void io_set_encoding(struct io *io, struct encoding *encoding);
 
 const char *get_temp_dir(void);
 
 bool PRINTF_LIKE(2, 3) io_fprintf(FILE *file, const char *fmt, ...);
 bool io_trace(const char *fmt, ...);
+double io_trace_clock(void);
+bool io_trace_spans(void);
+void io_trace_span(const char *name, double start, double end, const char *fmt, ...) PRINTF_LIKE(4, 5);
+void io_trace_owner(struct io *io, const char *owner);
 
 #endif
 /* vim: set ts=8 sw=8 noexpandtab: */
@@ -40,6 +40,7 @@ void *string_map_put(struct string_map *map, const char *key, void *value);
 void **string_map_put_to(struct string_map *map, const char *key);
 void *string_map_remove(struct string_map *map, const char *key);
 void string_map_clear(struct string_map *map);
+void string_map_free(struct string_map *map);
 void string_map_foreach(struct string_map *map, string_map_iterator_fn iterator, void *data);
 
 #define DEFINE_STRING_MAP(name, type, key_member, init_size) \
@@ -31,6 +31,8 @@ typedef struct view_column *view_settings;
 #endif
 
 #define OPTION_INFO(_) \
+	_(blame_cache,			bool,			VIEW_BLAME_LIKE) \
+	_(blame_jobs,			int,			VIEW_BLAME_LIKE) \
 	_(blame_options,		const char **,		VIEW_BLAME_LIKE) \
 	_(blame_view,			view_settings,		VIEW_NO_FLAGS) \
 	_(blob_view,			view_settings,		VIEW_NO_FLAGS) \
@@ -66,6 +68,8 @@ typedef struct view_column *view_settings;
 	_(refresh_mode,			enum refresh_mode,	VIEW_NO_FLAGS) \
 	_(refs_view,			view_settings,		VIEW_NO_FLAGS) \
 	_(rev_args,			const char **,		VIEW_NO_FLAGS) \
+	_(search_as_you_type,		bool,			VIEW_NO_FLAGS) \
+	_(search_threads,		int,			VIEW_NO_FLAGS) \
 	_(show_changes,			bool,			VIEW_NO_FLAGS) \
 	_(show_notes,			bool,			VIEW_NO_FLAGS) \
 	_(split_view_height,		double,			VIEW_RESET_DISPLAY) \
@@ -98,6 +98,7 @@ enum request {
 	REQ_SCROLL_WHEEL_UP,
 	REQ_MOVE_WHEEL_DOWN,
 	REQ_MOVE_WHEEL_UP,
+	REQ_STOP_SEARCH,
 
 	/* Start of the run request IDs */
 	REQ_RUN_REQUESTS
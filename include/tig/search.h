@@ -17,8 +17,12 @@
 #include "tig/view.h"
 
 void reset_search(struct view *view);
+void search_cache_drop(struct view *view);
 void search_view(struct view *view, enum request request);
 void find_next(struct view *view, enum request request);
+bool search_has_lines(struct view *view);
+void update_search(struct view *view);
+bool stop_search(struct view *view);
 void find_merge(struct view *view, enum request request);
 bool grep_text(struct view *view, const char *text[]);
 
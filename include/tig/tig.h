@@ -51,9 +51,13 @@
 #include <unistd.h>
 #include <sys/time.h>
 #include <sys/file.h>
+#include <dirent.h>
 #include <time.h>
 #include <fcntl.h>
 #include <termios.h>
+#include <poll.h>
+#include <spawn.h>
+#include <pthread.h>
 
 #include <regex.h>
 
@@ -95,6 +99,10 @@
 #undef FALSE
 #endif
 
+/* Storage private to each thread, for static buffers returned by helpers
+ * that are also called from the search threads. */
+#define THREAD_LOCAL __thread
+
 #if __GNUC__ >= 3
 #define TIG_NORETURN __attribute__((__noreturn__))
 #define PRINTF_LIKE(fmt, args) __attribute__((format (printf, fmt, args)))
@@ -159,7 +167,8 @@ void TIG_NORETURN usage(const char *message);
 	_(STASH,  stash), \
 	_(GREP,   grep), \
 	_(PAGER,  pager), \
-	_(HELP,   help)
+	_(HELP,   help), \
+	_(STATS,  stats)
 
 #endif
 
@@ -99,8 +99,9 @@ const char *mkstatus(const char status, enum status_label label);
  */
 
 void *chunk_allocator(void *mem, size_t type_size, size_t chunk_size, size_t size, size_t increase);
+void *geometric_allocator(void *mem, size_t type_size, size_t min_size, size_t size, size_t increase);
 
-#define DEFINE_ALLOCATOR(name, type, chunk_size)				\
+#define DEFINE_ALLOCATOR_(name, type, allocator, alloc_size)			\
 static type *									\
 name(type **mem, size_t size, size_t increase)					\
 {										\
@@ -110,12 +111,38 @@ name(type **mem, size_t size, size_t increase)					\
 	if (mem == NULL)							\
 		return NULL;							\
 										\
-	tmp = chunk_allocator(*mem, sizeof(type), chunk_size, size, increase);	\
+	tmp = allocator(*mem, sizeof(type), alloc_size, size, increase);	\
 	if (tmp)								\
 		*mem = tmp;							\
 	return tmp;								\
 }
 
+/* Grows the array in fixed steps of chunk_size elements. */
+#define DEFINE_ALLOCATOR(name, type, chunk_size) \
+	DEFINE_ALLOCATOR_(name, type, chunk_allocator, chunk_size)
+
+/* Doubles the capacity of the array starting from min_size elements. Use
+ * for arrays that can grow large, such as the view line index. */
+#define DEFINE_GEOMETRIC_ALLOCATOR(name, type, min_size) \
+	DEFINE_ALLOCATOR_(name, type, geometric_allocator, min_size)
+
+/*
+ * Arena allocator for data sharing the same lifetime. Memory is handed out
+ * from large slabs and can only be released all at once.
+ */
+
+struct arena_slab;
+
+struct arena {
+	struct arena_slab *slab;	/* Current slab. */
+	size_t slabs;			/* Number of allocated slabs. */
+	size_t allocs;			/* Number of allocations. */
+	size_t size;			/* Bytes allocated from the slabs. */
+};
+
+void *arena_alloc(struct arena *arena, size_t size);
+void arena_free(struct arena *arena);
+
 void sigsegv_handler(int sig);
 
 #endif
@@ -16,9 +16,11 @@
 
 #include "tig/tig.h"
 #include "tig/types.h"
+#include "tig/util.h"
 #include "tig/argv.h"
 #include "tig/watch.h"
 #include "tig/io.h"
+#include "tig/map.h"
 #include "tig/line.h"
 #include "tig/keys.h"
 #include "tig/options.h"
@@ -99,6 +101,27 @@ struct view_column {
 	bool hidden;
 };
 
+/* Cheap counters shown in the stats view. */
+struct view_stats {
+	size_t bytes;		/* Bytes of line data, reset with the lines. */
+	size_t allocs;		/* Line data allocations, reset with the lines. */
+	unsigned int commands;	/* Number of commands spawned. */
+	unsigned int redraws;	/* Number of times the view was redrawn. */
+	unsigned int loads;	/* Number of times the view was loaded. */
+	double load_start;	/* When the last load started. */
+	double load_time;	/* Duration of the last load, or 0 if loading. */
+	double read_time;	/* Time spent reading lines in the last load. */
+	double parse_time;	/* Time spent parsing lines in the last load. */
+	double draw_time;	/* Time spent drawing lines. */
+};
+
+/* Commit to select once loaded, see goto_id(). */
+struct view_goto {
+	char id[SIZEOF_REV];	/* Commit ID, empty when nothing is pending. */
+	unsigned long lineno;	/* First line not yet searched. */
+	bool save_search;	/* Save the ID as the search string. */
+};
+
 struct view {
 	const char *name;	/* View name */
 
@@ -125,8 +148,21 @@ struct view {
 	/* Searching */
 	char grep[SIZEOF_STR];	/* Search string */
 	regex_t *regex;		/* Pre-compiled regexp */
-	unsigned int *matched_line;
+	int grep_flags;		/* Flags the regexp was compiled with. */
+	bool grep_literal;	/* Search string has no regexp operators. */
+	char grep_first[3];	/* Case variants of its first character. */
+	unsigned int *matched_line;	/* Matches in the order they were found. */
 	size_t matched_lines;
+	bool searching;		/* Lines are searched by update_search(). */
+	int search_direction;	/* Direction of a search waiting for a match. */
+	size_t search_prev;	/* Lines from search_prev up to search_next */
+	size_t search_next;	/* ... have been searched. */
+	unsigned int *search_candidate;	/* Sorted lines that can match when */
+	size_t search_candidates;	/* narrowing a previous search. */
+	size_t search_candidate_prev;
+	size_t search_candidate_next;
+	size_t search_candidate_lines;	/* Lines the candidates were found in. */
+	bool search_changed;	/* Lines changed after being searched. */
 
 	/* If non-NULL, points to the view that opened this view. If this view
 	 * is closed tig will switch back to the parent view. */
@@ -136,11 +172,15 @@ struct view {
 	/* Buffering */
 	size_t lines;		/* Total number of lines */
 	struct line *line;	/* Line index */
+	struct arena arena;	/* Line data, released by reset_view(). */
+	struct string_map ids;	/* Line index by commit ID, see view_add_id(). */
 
 	/* Number of lines with custom status, not to be counted in the
 	 * view title. */
 	unsigned int custom_lines;
 
+	struct view_goto goto_pending;
+
 	/* Drawing */
 	struct line *curline;	/* Line currently being drawn. */
 	enum line_type curtype;	/* Attribute currently used for drawing. */
@@ -153,11 +193,13 @@ struct view {
 	const char *dir;	/* Directory from which to execute. */
 	struct io io;
 	struct io *pipe;
+	struct io *lookup_pipe;	/* Replies to lookups of column data. */
 	time_t start_time;
 	time_t update_secs;
 	struct encoding *encoding;
 	bool unrefreshable;
 	struct watch watch;
+	struct view_stats stats;
 
 	/* Private data */
 	void *private;
@@ -235,6 +277,9 @@ struct view_ops {
 	unsigned long column_bits;
 	/* Extract line information. */
 	bool (*get_column_data)(struct view *view, const struct line *line, struct view_column_data *column_data);
+	/* Read replies to lookups of column data, or when @sorting make
+	 * the data of the sort field available for all lines. */
+	void (*lookup)(struct view *view, bool sorting);
 };
 
 /*
@@ -259,6 +304,7 @@ void do_scroll_view(struct view *view, int lines);
 void scroll_view(struct view *view, enum request request);
 void move_view(struct view *view, enum request request);
 void goto_id(struct view *view, const char *expression, bool from_start, bool save_search);
+bool view_add_id(struct view *view, const char *id, unsigned long lineno);
 
 /*
  * View history
@@ -12,6 +12,7 @@
  */
 
 #include "tig/io.h"
+#include "tig/map.h"
 #include "tig/refdb.h"
 #include "tig/repo.h"
 #include "tig/options.h"
@@ -40,6 +41,9 @@ struct blame_history_state {
 
 static struct view_history blame_view_history = { sizeof(struct blame_history_state) };
 
+/* Commits referenced by the lines of the blame view. */
+DEFINE_STRING_MAP(blame_commits, struct blame_commit *, id, 32)
+
 struct blame {
 	struct blame_commit *commit;
 	unsigned long lineno;
@@ -48,10 +52,17 @@ struct blame {
 
 struct blame_state {
 	struct blame_commit *commit;
+	unsigned long lineno;	/* First line blamed on the current commit. */
 	char author[SIZEOF_STR];
 	int blamed;
 	bool done_reading;
 	bool auto_filename_display;
+	bool blaming_range;		/* Is a blame limited to the viewport running? */
+	struct io full_blame;		/* The full blame paused meanwhile. */
+	size_t jobs;			/* Number of merged blame processes. */
+	unsigned long long content_hash;	/* Hash of the file content. */
+	char cache_key[SIZEOF_STR];	/* Identifies the blame in the cache. */
+	char cache_path[SIZEOF_STR];	/* Where the blame is cached. */
 	const char *filename;
 	/* The history state for the current view is cached in the view
 	 * state so it always matches what was used to load the current blame
@@ -73,6 +84,30 @@ blame_update_file_name_visibility(struct view *view)
 			  !state->auto_filename_display);
 }
 
+static bool
+blame_free_commit(void *data, void *commit)
+{
+	free(commit);
+	return true;
+}
+
+/* Free the commits, unlinking them from any lines left if the view is
+ * not reloaded. */
+static void
+blame_free_commits(struct view *view)
+{
+	size_t i;
+
+	for (i = 0; i < view->lines; i++) {
+		struct blame *blame = view->line[i].data;
+
+		blame->commit = NULL;
+	}
+
+	string_map_foreach(&blame_commits, blame_free_commit, NULL);
+	string_map_clear(&blame_commits);
+}
+
 static enum status_code
 blame_open(struct view *view, enum open_flags flags)
 {
@@ -81,6 +116,8 @@ blame_open(struct view *view, enum open_flags flags)
 	char path[SIZEOF_STR];
 	size_t i;
 
+	blame_free_commits(view);
+
 	if (is_initial_view(view)) {
 		/* Finish validating and setting up blame options */
 		if (!opt_file_args || opt_file_args[1])
@@ -146,24 +183,6 @@ blame_open(struct view *view, enum open_flags flags)
 			return code;
 	}
 
-	/* First pass: remove multiple references to the same commit. */
-	for (i = 0; i < view->lines; i++) {
-		struct blame *blame = view->line[i].data;
-
-		if (blame->commit && blame->commit->id[0])
-			blame->commit->id[0] = 0;
-		else
-			blame->commit = NULL;
-	}
-
-	/* Second pass: free existing references. */
-	for (i = 0; i < view->lines; i++) {
-		struct blame *blame = view->line[i].data;
-
-		if (blame->commit)
-			free(blame->commit);
-	}
-
 	if (!(flags & OPEN_RELOAD))
 		reset_view_history(&blame_view_history);
 	string_copy_rev(state->history_state.id, view->env->ref);
@@ -177,27 +196,514 @@ blame_open(struct view *view, enum open_flags flags)
 }
 
 static struct blame_commit *
-get_blame_commit(struct view *view, const char *id)
+get_blame_commit(const char *id)
+{
+	struct blame_commit *commit = string_map_get(&blame_commits, id);
+
+	if (commit)
+		return commit;
+
+	commit = calloc(1, sizeof(*commit));
+	if (!commit)
+		return NULL;
+
+	string_ncopy(commit->id, id, SIZEOF_REV);
+	if (!string_map_put(&blame_commits, commit->id, commit)) {
+		free(commit);
+		return NULL;
+	}
+
+	return commit;
+}
+
+/*
+ * Blame cache
+ *
+ * Finished blames are stored in $GIT_DIR/tig/blame/ so blaming the same
+ * file content again does not have to wait for git-blame. The cache is
+ * keyed by the blamed commit, the path, the blame options and a hash of
+ * the file content. Each file lists the commits followed by the ranges
+ * of lines blamed on them. Numbers are stored in little-endian byte order
+ * and the magic line is bumped whenever the format changes. Only the most
+ * recently used files are kept.
+ */
+
+#define BLAME_CACHE_MAGIC	"tig-blame-cache 2\n"
+#define BLAME_CACHE_HASH	0xcbf29ce484222325ULL
+#define BLAME_CACHE_FILES	256
+
+/* FNV-1a */
+static unsigned long long
+blame_cache_hash(unsigned long long hash, const char *data, size_t size)
+{
+	while (size--) {
+		hash ^= (unsigned char) *data++;
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static bool
+blame_cache_init(struct view *view)
+{
+	struct blame_state *state = view->private;
+	char ref[SIZEOF_STR];
+	const char *rev_parse_argv[] = {
+		"git", "rev-parse", "--verify", "--quiet", ref, NULL
+	};
+	char id[SIZEOF_STR];
+	char options[SIZEOF_STR] = "";
+
+	if (!opt_blame_cache || !*repo.git_dir)
+		return false;
+
+	if (!string_format(ref, "%s^{commit}", *view->env->ref ? view->env->ref : "HEAD") ||
+	    !io_run_buf(rev_parse_argv, id, sizeof(id), repo.cdup, false) ||
+	    strlen(id) != SIZEOF_REV - 1)
+		return false;
+
+	if (opt_blame_options &&
+	    !argv_to_string(opt_blame_options, options, sizeof(options), " "))
+		return false;
+
+	if (!string_format(state->cache_key, "%s %016llx %s\t%s", id,
+			   state->content_hash, options, view->env->file) ||
+	    !string_format(state->cache_path, "%s/tig/blame/%016llx", repo.git_dir,
+			   blame_cache_hash(BLAME_CACHE_HASH, state->cache_key,
+					    strlen(state->cache_key)))) {
+		state->cache_path[0] = 0;
+		return false;
+	}
+
+	return true;
+}
+
+struct blame_cache_reader {
+	const char *pos, *end;
+};
+
+static bool
+blame_cache_read(struct blame_cache_reader *reader, void *data, size_t size)
+{
+	if (reader->end - reader->pos < size)
+		return false;
+	memcpy(data, reader->pos, size);
+	reader->pos += size;
+	return true;
+}
+
+static bool
+blame_cache_read_number(struct blame_cache_reader *reader, unsigned long long *value, size_t size)
+{
+	unsigned char bytes[8];
+
+	if (!blame_cache_read(reader, bytes, size))
+		return false;
+	for (*value = 0; size > 0; size--)
+		*value = (*value << 8) | bytes[size - 1];
+	return true;
+}
+
+static bool
+blame_cache_read_uint(struct blame_cache_reader *reader, unsigned int *value)
+{
+	unsigned long long number;
+
+	if (!blame_cache_read_number(reader, &number, 4))
+		return false;
+	*value = number;
+	return true;
+}
+
+static bool
+blame_cache_read_string(struct blame_cache_reader *reader, char buf[SIZEOF_STR])
+{
+	unsigned long long size;
+
+	if (!blame_cache_read_number(reader, &size, 2) || size >= SIZEOF_STR ||
+	    !blame_cache_read(reader, buf, size))
+		return false;
+	buf[size] = 0;
+	return true;
+}
+
+static bool
+blame_cache_read_commit(struct blame_cache_reader *reader, struct blame_commit **commit_ptr)
+{
+	struct blame_commit *commit;
+	char id[SIZEOF_STR], title[SIZEOF_STR], name[SIZEOF_STR], email[SIZEOF_STR];
+	char filename[SIZEOF_STR], parent_id[SIZEOF_STR], parent_filename[SIZEOF_STR];
+	unsigned long long sec, tz;
+
+	if (!blame_cache_read_string(reader, id) ||
+	    !blame_cache_read_number(reader, &sec, 8) ||
+	    !blame_cache_read_number(reader, &tz, 4) ||
+	    !blame_cache_read_string(reader, title) ||
+	    !blame_cache_read_string(reader, name) ||
+	    !blame_cache_read_string(reader, email) ||
+	    !blame_cache_read_string(reader, filename) ||
+	    !blame_cache_read_string(reader, parent_id) ||
+	    !blame_cache_read_string(reader, parent_filename))
+		return false;
+
+	commit = get_blame_commit(id);
+	if (!commit)
+		return false;
+
+	commit->time.sec = (long long) sec;
+	commit->time.tz = (int32_t) tz;
+	string_ncopy(commit->title, title, strlen(title));
+	commit->author = get_author(name, email);
+	commit->filename = get_path(filename);
+	string_ncopy(commit->parent_id, parent_id, strlen(parent_id));
+	commit->parent_filename = *parent_filename ? get_path(parent_filename) : NULL;
+
+	*commit_ptr = commit;
+	return commit->author && commit->filename;
+}
+
+static bool
+blame_cache_parse(struct view *view, struct blame_cache_reader *reader)
+{
+	struct blame_state *state = view->private;
+	struct blame_commit **commits = NULL;
+	unsigned int commits_count, ranges_count, i;
+	bool ok = false;
+
+	if (!blame_cache_read_uint(reader, &commits_count) ||
+	    !blame_cache_read_uint(reader, &ranges_count) ||
+	    !(commits = calloc(commits_count, sizeof(*commits))))
+		return false;
+
+	for (i = 0; i < commits_count; i++)
+		if (!blame_cache_read_commit(reader, &commits[i]))
+			goto out;
+
+	for (i = 0; i < ranges_count; i++) {
+		unsigned int range[4], lineno, index;
+
+		if (!blame_cache_read_uint(reader, &range[0]) ||
+		    !blame_cache_read_uint(reader, &range[1]) ||
+		    !blame_cache_read_uint(reader, &range[2]) ||
+		    !blame_cache_read_uint(reader, &range[3]) ||
+		    range[0] >= view->lines || range[1] > view->lines - range[0] ||
+		    range[2] >= commits_count)
+			goto out;
+
+		for (lineno = range[0], index = 0; index < range[1]; index++, lineno++) {
+			struct blame *blame = view->line[lineno].data;
+
+			blame->commit = commits[range[2]];
+			blame->lineno = range[3] + index;
+		}
+		state->blamed += range[1];
+
+		if (!state->filename) {
+			state->filename = commits[range[2]]->filename;
+		} else if (strcmp(state->filename, commits[range[2]]->filename)) {
+			state->auto_filename_display = true;
+			blame_update_file_name_visibility(view);
+		}
+		view_column_info_update(view, &view->line[range[0]]);
+	}
+
+	ok = reader->pos == reader->end;
+
+out:
+	free(commits);
+	return ok;
+}
+
+static bool
+blame_cache_load(struct view *view)
+{
+	struct blame_state *state = view->private;
+	struct blame_cache_reader reader;
+	struct stat st;
+	char *data;
+	size_t keylen;
+	bool ok = false;
+	FILE *file;
+
+	if (!blame_cache_init(view))
+		return false;
+
+	file = fopen(state->cache_path, "rb");
+	if (!file)
+		return false;
+
+	if (!fstat(fileno(file), &st) && (data = malloc(st.st_size))) {
+		if (fread(data, 1, st.st_size, file) == st.st_size) {
+			reader.pos = data;
+			reader.end = data + st.st_size;
+			keylen = strlen(state->cache_key);
+
+			ok = st.st_size > STRING_SIZE(BLAME_CACHE_MAGIC) + keylen &&
+			     !memcmp(reader.pos, BLAME_CACHE_MAGIC, STRING_SIZE(BLAME_CACHE_MAGIC)) &&
+			     !memcmp(reader.pos + STRING_SIZE(BLAME_CACHE_MAGIC), state->cache_key, keylen) &&
+			     reader.pos[STRING_SIZE(BLAME_CACHE_MAGIC) + keylen] == '\n';
+			reader.pos += STRING_SIZE(BLAME_CACHE_MAGIC) + keylen + 1;
+			ok = ok && blame_cache_parse(view, &reader) && state->blamed == view->lines;
+		}
+		free(data);
+	}
+	fclose(file);
+
+	/* Mark the file as recently used so it is kept when pruning. */
+	if (ok)
+		utimes(state->cache_path, NULL);
+
+	/* Leave a partially applied cache to git-blame. */
+	if (!ok && state->blamed) {
+		size_t i;
+
+		for (i = 0; i < view->lines; i++) {
+			struct blame *blame = view->line[i].data;
+
+			blame->commit = NULL;
+		}
+		state->blamed = 0;
+		state->filename = NULL;
+	}
+
+	return ok;
+}
+
+static bool
+blame_cache_write(FILE *file, const void *data, size_t size)
+{
+	return fwrite(data, 1, size, file) == size;
+}
+
+static bool
+blame_cache_write_number(FILE *file, unsigned long long value, size_t size)
+{
+	unsigned char bytes[8];
+	size_t i;
+
+	for (i = 0; i < size; i++, value >>= 8)
+		bytes[i] = value & 0xff;
+	return blame_cache_write(file, bytes, size);
+}
+
+static bool
+blame_cache_write_string(FILE *file, const char *string)
 {
+	size_t size = string ? strlen(string) : 0;
+
+	return size < SIZEOF_STR &&
+	       blame_cache_write_number(file, size, 2) &&
+	       blame_cache_write(file, string, size);
+}
+
+static bool
+blame_cache_write_commit(FILE *file, struct blame_commit *commit)
+{
+	return blame_cache_write_string(file, commit->id) &&
+	       blame_cache_write_number(file, commit->time.sec, 8) &&
+	       blame_cache_write_number(file, (unsigned int) commit->time.tz, 4) &&
+	       blame_cache_write_string(file, commit->title) &&
+	       blame_cache_write_string(file, commit->author->name) &&
+	       blame_cache_write_string(file, commit->author->email) &&
+	       blame_cache_write_string(file, commit->filename) &&
+	       blame_cache_write_string(file, commit->parent_id) &&
+	       blame_cache_write_string(file, commit->parent_filename);
+}
+
+struct blame_cache_commit {
+	const char *id;
+	unsigned int index;
+};
+
+DEFINE_STRING_MAP(blame_cache_commits, struct blame_cache_commit *, id, 32)
+DEFINE_ALLOCATOR(blame_cache_realloc_commits, struct blame_commit *, 256)
+
+static bool
+blame_cache_free_commit(void *data, void *value)
+{
+	free(value);
+	return true;
+}
+
+/* Number the commits in order of appearance and count the ranges of
+ * consecutive lines blamed on the same commit. */
+static bool
+blame_cache_index(struct view *view, struct blame_commit ***commits,
+		  unsigned int *commits_count, unsigned int *ranges_count)
+{
+	struct blame *prev = NULL;
 	size_t i;
 
 	for (i = 0; i < view->lines; i++) {
 		struct blame *blame = view->line[i].data;
+		struct blame_cache_commit **entry;
 
-		if (!blame->commit)
+		if (!blame->commit || string_rev_is_null(blame->commit->id) ||
+		    !blame->commit->author || !blame->commit->filename)
+			return false;
+
+		if (prev && prev->commit == blame->commit && prev->lineno + 1 == blame->lineno) {
+			prev = blame;
 			continue;
+		}
 
-		if (!strncmp(blame->commit->id, id, SIZEOF_REV - 1))
-			return blame->commit;
+		prev = blame;
+		(*ranges_count)++;
+
+		entry = (struct blame_cache_commit **) string_map_put_to(&blame_cache_commits, blame->commit->id);
+		if (!entry)
+			return false;
+		if (*entry)
+			continue;
+
+		if (!blame_cache_realloc_commits(commits, *commits_count, 1) ||
+		    !(*entry = calloc(1, sizeof(**entry))))
+			return false;
+		(*entry)->id = blame->commit->id;
+		(*entry)->index = *commits_count;
+		(*commits)[(*commits_count)++] = blame->commit;
 	}
 
-	{
-		struct blame_commit *commit = calloc(1, sizeof(*commit));
+	return true;
+}
 
-		if (commit)
-			string_ncopy(commit->id, id, SIZEOF_REV);
-		return commit;
+static bool
+blame_cache_write_range(FILE *file, unsigned int range[4])
+{
+	return blame_cache_write_number(file, range[0], 4) &&
+	       blame_cache_write_number(file, range[1], 4) &&
+	       blame_cache_write_number(file, range[2], 4) &&
+	       blame_cache_write_number(file, range[3], 4);
+}
+
+static bool
+blame_cache_write_ranges(FILE *file, struct view *view)
+{
+	unsigned int range[4] = {0};
+	size_t i;
+
+	for (i = 0; i < view->lines; i++) {
+		struct blame *blame = view->line[i].data;
+
+		if (i > 0) {
+			struct blame *prev = view->line[i - 1].data;
+
+			if (prev->commit == blame->commit && prev->lineno + 1 == blame->lineno) {
+				range[1]++;
+				continue;
+			}
+
+			if (!blame_cache_write_range(file, range))
+				return false;
+		}
+
+		range[0] = i;
+		range[1] = 1;
+		range[2] = ((struct blame_cache_commit *) string_map_get(&blame_cache_commits, blame->commit->id))->index;
+		range[3] = blame->lineno;
+	}
+
+	return blame_cache_write_range(file, range);
+}
+
+struct blame_cache_file {
+	time_t mtime;
+	char name[32];
+};
+
+DEFINE_ALLOCATOR(blame_cache_realloc_files, struct blame_cache_file, 256)
+
+static int
+blame_cache_file_compare(const void *a, const void *b)
+{
+	const struct blame_cache_file *file1 = a;
+	const struct blame_cache_file *file2 = b;
+
+	return (file1->mtime > file2->mtime) - (file1->mtime < file2->mtime);
+}
+
+/* Remove the least recently used files when there are too many. */
+static void
+blame_cache_prune(const char *dir)
+{
+	struct blame_cache_file *files = NULL;
+	size_t files_count = 0, i;
+	struct dirent *entry;
+	DIR *dirp = opendir(dir);
+
+	if (!dirp)
+		return;
+
+	while ((entry = readdir(dirp))) {
+		size_t namelen = strlen(entry->d_name);
+		char path[SIZEOF_STR];
+		struct stat st;
+
+		if (*entry->d_name == '.' || namelen >= sizeof(files->name) ||
+		    !string_format(path, "%s/%s", dir, entry->d_name) ||
+		    stat(path, &st) || !S_ISREG(st.st_mode))
+			continue;
+
+		if (!blame_cache_realloc_files(&files, files_count, 1))
+			break;
+		files[files_count].mtime = st.st_mtime;
+		string_ncopy(files[files_count].name, entry->d_name, namelen);
+		files_count++;
 	}
+	closedir(dirp);
+
+	if (files_count > BLAME_CACHE_FILES) {
+		qsort(files, files_count, sizeof(*files), blame_cache_file_compare);
+		for (i = 0; i < files_count - BLAME_CACHE_FILES; i++) {
+			char path[SIZEOF_STR];
+
+			if (string_format(path, "%s/%s", dir, files[i].name))
+				unlink(path);
+		}
+	}
+
+	free(files);
+}
+
+static void
+blame_cache_save(struct view *view)
+{
+	struct blame_state *state = view->private;
+	struct blame_commit **commits = NULL;
+	unsigned int commits_count = 0, ranges_count = 0, i;
+	char dir[SIZEOF_STR], tmp[SIZEOF_STR];
+	bool ok = false;
+	FILE *file;
+
+	if (!*state->cache_path ||
+	    !blame_cache_index(view, &commits, &commits_count, &ranges_count) ||
+	    !string_format(dir, "%s/tig", repo.git_dir) ||
+	    (mkdir(dir, 0777) && errno != EEXIST) ||
+	    !string_format(dir, "%s/tig/blame", repo.git_dir) ||
+	    (mkdir(dir, 0777) && errno != EEXIST) ||
+	    !string_format(tmp, "%s.%d", state->cache_path, (int) getpid()) ||
+	    !(file = fopen(tmp, "wb")))
+		goto out;
+
+	ok = blame_cache_write(file, BLAME_CACHE_MAGIC, STRING_SIZE(BLAME_CACHE_MAGIC)) &&
+	     blame_cache_write(file, state->cache_key, strlen(state->cache_key)) &&
+	     blame_cache_write(file, "\n", 1) &&
+	     blame_cache_write_number(file, commits_count, 4) &&
+	     blame_cache_write_number(file, ranges_count, 4);
+	for (i = 0; ok && i < commits_count; i++)
+		ok = blame_cache_write_commit(file, commits[i]);
+	ok = ok && blame_cache_write_ranges(file, view);
+
+	if (fclose(file) || !ok || rename(tmp, state->cache_path))
+		unlink(tmp);
+	else
+		blame_cache_prune(dir);
+
+out:
+	string_map_foreach(&blame_cache_commits, blame_cache_free_commit, NULL);
+	string_map_clear(&blame_cache_commits);
+	free(commits);
 }
 
 static struct blame_commit *
@@ -210,15 +716,18 @@ read_blame_commit(struct view *view, const char *text, struct blame_state *state
 	if (!parse_blame_header(&header, text, view->lines))
 		return NULL;
 
-	commit = get_blame_commit(view, text);
+	commit = get_blame_commit(header.id);
 	if (!commit)
 		return NULL;
 
-	state->blamed += header.group;
+	state->lineno = header.lineno - 1;
 	while (header.group--) {
 		struct line *line = &view->line[header.lineno + header.group - 1];
 
 		blame = line->data;
+		/* Lines may be blamed both by a range and the full blame. */
+		if (!blame->commit)
+			state->blamed++;
 		blame->commit = commit;
 		blame->lineno = header.orig_lineno + header.group - 1;
 		line->dirty = 1;
@@ -227,19 +736,155 @@ read_blame_commit(struct view *view, const char *text, struct blame_state *state
 	return commit;
 }
 
+#define BLAME_ARGV(view, range) { \
+	"git", "blame", encoding_arg, "%(blameargs)", "--incremental", \
+		(range) ? (range) : "--incremental", \
+		*(view)->env->ref ? (view)->env->ref : "--incremental", "--", (view)->env->file, NULL \
+}
+
+static enum status_code
+begin_blame_update(struct view *view)
+{
+	const char *blame_argv[] = BLAME_ARGV(view, NULL);
+
+	return begin_update(view, repo.cdup, blame_argv, OPEN_EXTRA);
+}
+
+static bool
+blame_has_range_option(void)
+{
+	int i;
+
+	for (i = 0; opt_blame_options && opt_blame_options[i]; i++)
+		if (!prefixcmp(opt_blame_options[i], "-L"))
+			return true;
+	return false;
+}
+
+/* Minimum number of lines blamed by each job. */
+#define BLAME_JOB_LINES	1000
+
+/* Split the blame of large files in line ranges blamed by concurrent
+ * git-blame processes. Their output is merged record by record into the
+ * view's pipe, each record ending with the "filename" line, so it can
+ * be read like the output of a single process. */
+static bool
+begin_blame_jobs(struct view *view)
+{
+	struct blame_state *state = view->private;
+	size_t jobs = MIN(opt_blame_jobs, view->lines / BLAME_JOB_LINES);
+	struct io *inputs;
+	size_t i;
+
+	if (jobs < 2 || blame_has_range_option())
+		return false;
+
+	inputs = calloc(jobs, sizeof(*inputs));
+	if (!inputs)
+		return false;
+
+	for (i = 0; i < jobs; i++) {
+		char range_arg[SIZEOF_STR];
+		const char *range = range_arg;
+		const char *blame_argv[] = BLAME_ARGV(view, range);
+		const char **argv = NULL;
+		bool ok;
+
+		if (!string_format(range_arg, "-L%zu,%zu", view->lines * i / jobs + 1,
+				   view->lines * (i + 1) / jobs))
+			break;
+
+		ok = argv_format(view->env, &argv, blame_argv, false, true) &&
+		     io_run(&inputs[i], IO_RD, repo.cdup, NULL, argv);
+		argv_free(argv);
+		free(argv);
+		if (!ok)
+			break;
+	}
+
+	if (i < jobs) {
+		while (i--) {
+			io_kill(&inputs[i]);
+			io_done(&inputs[i]);
+		}
+		free(inputs);
+		return false;
+	}
+
+	io_done(view->pipe);
+	if (!io_merge(&view->io, inputs, jobs, "filename ")) {
+		free(inputs);
+		return false;
+	}
+
+	free(inputs);
+	view->pipe = &view->io;
+	view->stats.commands += jobs;
+	state->jobs = jobs;
+	return true;
+}
+
+static bool
+blame_line_is_blamed(struct view *view, unsigned long lineno)
+{
+	struct blame *blame = view->line[lineno].data;
+
+	return !!blame->commit;
+}
+
+/* Blame the lines in the viewport first. The full blame is paused by
+ * not reading from it while a blame limited to the viewport's unblamed
+ * lines runs in its place. When it is done the full blame resumes,
+ * see blame_read(). The view's arguments are left untouched so the
+ * whole file is blamed when the view is refreshed. */
+static void
+blame_viewport(struct view *view)
+{
+	struct blame_state *state = view->private;
+	unsigned long first = view->pos.offset;
+	unsigned long last = MIN(view->pos.offset + view->height, view->lines);
+	char range_arg[SIZEOF_STR];
+	const char *range = range_arg;
+	const char *blame_argv[] = BLAME_ARGV(view, range);
+	const char **argv = NULL;
+	bool ok;
+
+	if (!view->pipe || !state->done_reading || state->blaming_range ||
+	    state->jobs || state->commit || view->lines <= view->height ||
+	    blame_has_range_option())
+		return;
+
+	while (first < last && blame_line_is_blamed(view, first))
+		first++;
+	while (last > first && blame_line_is_blamed(view, last - 1))
+		last--;
+	if (first == last || !string_format(range_arg, "-L%lu,%lu", first + 1, last))
+		return;
+
+	state->full_blame = view->io;
+	ok = argv_format(view->env, &argv, blame_argv, false, true) &&
+	     io_run(&view->io, IO_RD, repo.cdup, NULL, argv);
+	argv_free(argv);
+	free(argv);
+
+	if (!ok) {
+		view->io = state->full_blame;
+		return;
+	}
+
+	io_trace_owner(&view->io, view->name);
+	view->stats.commands++;
+	state->blaming_range = true;
+}
+
 static bool
 blame_read_file(struct view *view, struct buffer *buf, struct blame_state *state)
 {
 	if (!buf) {
-		const char *blame_argv[] = {
-			"git", "blame", encoding_arg, "%(blameargs)", "--incremental",
-				*view->env->ref ? view->env->ref : "--incremental", "--", view->env->file, NULL
-		};
-
 		if (failed_to_load_initial_view(view))
 			die("No blame exist for %s", view->vid);
 
-		if (view->lines == 0 || begin_update(view, repo.cdup, blame_argv, OPEN_EXTRA) != SUCCESS) {
+		if (view->lines == 0) {
 			report("Failed to load blame data");
 			return true;
 		}
@@ -250,17 +895,32 @@ blame_read_file(struct view *view, struct buffer *buf, struct blame_state *state
 		}
 
 		state->done_reading = true;
+		if (blame_cache_load(view)) {
+			string_format(view->ref, "%s", view->vid);
+			return true;
+		}
+
+		if (!begin_blame_jobs(view) && begin_blame_update(view) != SUCCESS) {
+			report("Failed to load blame data");
+			return true;
+		}
+
+		blame_viewport(view);
 		return false;
 
 	} else {
 		struct blame *blame;
 
+		if (!view->lines)
+			state->content_hash = BLAME_CACHE_HASH;
 		if (!add_line_alloc(view, &blame, LINE_DEFAULT, buf->size, false))
 			return false;
 
 		blame->commit = NULL;
 		strncpy(blame->text, buf->data, buf->size);
 		blame->text[buf->size] = 0;
+		state->content_hash = blame_cache_hash(state->content_hash, buf->data, buf->size);
+		state->content_hash = blame_cache_hash(state->content_hash, "\n", 1);
 		return true;
 	}
 }
@@ -274,6 +934,20 @@ blame_read(struct view *view, struct buffer *buf, bool force_stop)
 		return blame_read_file(view, buf, state);
 
 	if (!buf) {
+		if (state->blaming_range) {
+			if (force_stop)
+				io_kill(&view->io);
+			io_done(&view->io);
+			view->io = state->full_blame;
+			state->blaming_range = false;
+			/* When stopping, the full blame is killed by end_update(). */
+			if (!force_stop)
+				return false;
+		}
+
+		if (!force_stop && state->blamed == view->lines)
+			blame_cache_save(view);
+
 		string_format(view->ref, "%s", view->vid);
 		if (view_is_displayed(view)) {
 			update_view_title(view);
@@ -288,9 +962,6 @@ blame_read(struct view *view, struct buffer *buf, bool force_stop)
 			      view->lines ? 5 * (size_t) (state->blamed * 20 / view->lines) : 0);
 
 	} else if (parse_blame_info(state->commit, state->author, buf->data)) {
-		bool update_view_columns = true;
-		int i;
-
 		if (!state->commit->filename)
 			return false;
 
@@ -302,18 +973,9 @@ blame_read(struct view *view, struct buffer *buf, bool force_stop)
 			blame_update_file_name_visibility(view);
 		}
 
-		for (i = 0; i < view->lines; i++) {
-			struct line *line = &view->line[i];
-			struct blame *blame = line->data;
-
-			if (blame && blame->commit == state->commit) {
-				line->dirty = 1;
-				if (update_view_columns)
-					view_column_info_update(view, line);
-				update_view_columns = false;
-			}
-		}
-
+		/* The lines of this group were marked dirty when read so only
+		 * the column widths need updating. */
+		view_column_info_update(view, &view->line[state->lineno]);
 		state->commit = NULL;
 	}
 
@@ -504,6 +1166,9 @@ blame_select(struct view *view, struct line *line)
 	struct blame *blame = line->data;
 	struct blame_commit *commit = blame->commit;
 
+	/* Re-prioritise when scrolled to lines not blamed yet. */
+	blame_viewport(view);
+
 	if (!commit)
 		return;
 
@@ -517,6 +1182,17 @@ blame_select(struct view *view, struct line *line)
 	view->env->lineno = view->pos.lineno + 1;
 }
 
+static void
+blame_done(struct view *view)
+{
+	struct blame_state *state = view->private;
+
+	if (state->blaming_range) {
+		io_kill(&state->full_blame);
+		io_done(&state->full_blame);
+	}
+}
+
 static struct view_ops blame_ops = {
 	"line",
 	argv_env.commit,
@@ -528,7 +1204,7 @@ static struct view_ops blame_ops = {
 	blame_request,
 	view_column_grep,
 	blame_select,
-	NULL,
+	blame_done,
 	view_column_bit(AUTHOR) | view_column_bit(DATE) |
 		view_column_bit(FILE_NAME) | view_column_bit(ID) |
 		view_column_bit(LINE_NUMBER) | view_column_bit(TEXT),
@@ -18,6 +18,7 @@
 #include "tig/options.h"
 #include "tig/view.h"
 #include "tig/draw.h"
+#include "tig/search.h"
 #include "tig/display.h"
 #include "tig/watch.h"
 
@@ -39,7 +40,7 @@ static struct display_tty opt_tty = { NULL, -1, NULL };
 
 static struct io script_io = { -1 };
 
-static bool
+bool
 is_script_executing(void)
 {
 	return script_io.pipe != -1;
@@ -725,6 +726,44 @@ get_input_char(void)
 	return getc(opt_tty.file);
 }
 
+/* One slot for each view's pipe, then one for each view's lookup pipe,
+ * followed by one for the terminal. */
+#define VIEW_INPUT_FD(id, name)	{ -1, POLLIN }
+static struct pollfd input_fds[] = { VIEW_INFO(VIEW_INPUT_FD), VIEW_INFO(VIEW_INPUT_FD), { -1, POLLIN } };
+#define TTY_INPUT_FD		(ARRAY_SIZE(input_fds) - 1)
+#define LOOKUP_INPUT_FD(i)	(TTY_INPUT_FD / 2 + (i))
+
+/* Views still loading are checked at least this often (in ms) to keep
+ * the title's loading time up to date. */
+#define LOADING_DELAY		1000
+
+/* Wait until the terminal or any of the view pipes become readable, or
+ * the delay expires. On timeout all views are marked as readable so they
+ * are given a chance to update. */
+static void
+wait_input(bool tty, int delay)
+{
+	struct view *view;
+	int i, ready;
+
+	foreach_view (view, i) {
+		input_fds[i].fd = view->pipe ? view->pipe->pipe : -1;
+		/* Content already read into memory is ready right away. */
+		if (view->pipe && input_fds[i].fd == -1)
+			delay = 0;
+		input_fds[LOOKUP_INPUT_FD(i)].fd = view->lookup_pipe ? view->lookup_pipe->pipe : -1;
+	}
+	input_fds[TTY_INPUT_FD].fd = tty ? opt_tty.fd : -1;
+
+	ready = poll(input_fds, ARRAY_SIZE(input_fds), delay);
+	if (ready < 0 && errno != EINTR && errno != EAGAIN)
+		die("Failed to wait for input: %s", strerror(errno));
+
+	if (ready == 0)
+		foreach_view (view, i)
+			input_fds[i].revents = POLLIN;
+}
+
 int
 get_input(int prompt_position, struct key *key)
 {
@@ -736,7 +775,14 @@ get_input(int prompt_position, struct key *key)
 
 	memset(key, 0, sizeof(*key));
 
+	/* Check all views the first time around. */
+	foreach_view (view, i)
+		input_fds[i].revents = POLLIN;
+
 	while (true) {
+		bool loading = false;
+		bool searching = false;
+		bool finding = false;
 		int delay = -1;
 
 		if (opt_refresh_mode == REFRESH_MODE_PERIODIC) {
@@ -755,13 +801,24 @@ get_input(int prompt_position, struct key *key)
 		}
 
 		foreach_view (view, i) {
-			update_view(view);
+			if (input_fds[i].revents)
+				update_view(view);
+			input_fds[i].revents = 0;
+			if (input_fds[LOOKUP_INPUT_FD(i)].revents && view->lookup_pipe)
+				view->ops->lookup(view, false);
+			input_fds[LOOKUP_INPUT_FD(i)].revents = 0;
 			if (view_is_displayed(view) && view->has_scrolled &&
 			    use_scroll_redrawwin)
 				redrawwin(view->win);
 			view->has_scrolled = false;
-			if (view->pipe)
-				delay = 0;
+			if (view->pipe || view->lookup_pipe)
+				loading = true;
+			if (search_has_lines(view) || view->search_direction)
+				update_search(view);
+			if (search_has_lines(view))
+				searching = true;
+			if (view->search_direction)
+				finding = true;
 		}
 
 		/* Update the cursor position. */
@@ -777,23 +834,37 @@ get_input(int prompt_position, struct key *key)
 		set_cursor_pos(cursor_y, cursor_x);
 
 		if (is_script_executing()) {
-			/* Wait for the current command to complete. */
-			if (delay == 0 || !read_script(key))
+			/* Wait for the current command to complete. Searches
+			 * only hold up the script while a find request waits
+			 * for its match. */
+			if (loading || finding) {
+				wait_input(false, finding ? 0 : LOADING_DELAY);
+				continue;
+			}
+			if (!read_script(key))
 				continue;
 			return key->modifiers.multibytes ? OK : key->data.value;
 
 		} else {
 			/* Refresh, accept single keystroke of input */
 			doupdate();
-			wtimeout(status_win, delay);
+			wtimeout(status_win, 0);
 			key_value = wgetch(status_win);
 		}
 
-		/* wgetch() with nodelay() enabled returns ERR when
-		 * there's no input. */
+		/* Input already buffered by curses is consumed above, so
+		 * block until the terminal or a view pipe becomes readable. */
 		if (key_value == ERR) {
+			if (loading && (delay < 0 || delay > LOADING_DELAY))
+				delay = LOADING_DELAY;
+			wait_input(true, searching ? 0 : delay);
+			continue;
+		}
+
+		/* Remaining bytes of multibyte keys use the normal delay. */
+		wtimeout(status_win, delay);
 
-		} else if (key_value == KEY_RESIZE) {
+		if (key_value == KEY_RESIZE) {
 			int height, width;
 
 			getmaxyx(stdscr, height, width);
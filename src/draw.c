@@ -603,6 +603,7 @@ draw_view_line(struct view *view, unsigned int lineno)
 {
 	struct line *line;
 	bool selected = (view->pos.offset + lineno == view->pos.lineno);
+	double start;
 	bool ok;
 
 	/* FIXME: Disabled during code split.
@@ -613,6 +614,7 @@ draw_view_line(struct view *view, unsigned int lineno)
 		return false;
 
 	line = &view->line[view->pos.offset + lineno];
+	start = io_trace_clock();
 
 	wmove(view->win, lineno, 0);
 	if (line->cleareol)
@@ -626,7 +628,8 @@ draw_view_line(struct view *view, unsigned int lineno)
 	if (selected) {
 		set_view_attr(view, LINE_CURSOR);
 		line->selected = true;
-		view->ops->select(view, line);
+		if (view->ops->select)
+			view->ops->select(view, line);
 	}
 
 	ok = view->ops->draw(view, line, lineno);
@@ -634,6 +637,7 @@ draw_view_line(struct view *view, unsigned int lineno)
 	if (ok && line->search_result && view->regex)
 		draw_view_line_search_result(view, lineno);
 
+	view->stats.draw_time += io_trace_clock() - start;
 	return ok;
 }
 
@@ -655,6 +659,11 @@ redraw_view_dirty(struct view *view)
 
 	if (!dirty)
 		return;
+	if (view->force_redraw) {
+		redraw_view(view);
+		return;
+	}
+	view->stats.redraws++;
 	wnoutrefresh(view->win);
 }
 
@@ -672,12 +681,19 @@ redraw_view_from(struct view *view, int lineno)
 		}
 	}
 
+	view->force_redraw = false;
 	for (; lineno < view->height; lineno++) {
 		if (!draw_view_line(view, lineno))
 			break;
 	}
 
+	view->stats.redraws++;
 	wnoutrefresh(view->win);
+
+	/* Data loaded while drawing, such as file sizes in the tree
+	 * view, may have widened the columns. */
+	if (view->force_redraw)
+		redraw_view(view);
 }
 
 void
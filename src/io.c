@@ -11,22 +11,27 @@
  * GNU General Public License for more details.
  */
 
+/* Declares posix_spawn_file_actions_addchdir_np() on glibc. */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "tig/tig.h"
 #include "tig/util.h"
 #include "tig/io.h"
+#include "tig/map.h"
 
 /*
  * Encoding conversion.
  */
 
-#define ENCODING_SEP	": encoding: "
 #define ENCODING_ARG	"--encoding=" ENCODING_UTF8
 
-#define CHARSET_SEP	"; charset="
 
 struct encoding {
 	struct encoding *next;
 	iconv_t cd;
+	bool utf8;		/* Is input valid as UTF-8 passed through as is? */
 	char fromcode[1];
 };
 
@@ -55,6 +60,10 @@ encoding_open(const char *fromcode)
 		free(encoding);
 		return NULL;
 	}
+	encoding->utf8 = !strcasecmp(fromcode, ENCODING_UTF8) ||
+			 !strcasecmp(fromcode, "utf8") ||
+			 !strcasecmp(fromcode, "us-ascii") ||
+			 !strcasecmp(fromcode, "ascii");
 
 	encoding->next = encodings;
 	encodings = encoding;
@@ -81,10 +90,52 @@ encoding_convert_string(iconv_t iconv_cd, struct buffer *buf)
 	return (ret != (size_t) -1);
 }
 
-bool
-encoding_convert(struct encoding *encoding, struct buffer *buf)
+/* Returns the length of the valid UTF-8 prefix. If shorter than the data,
+ * error is set to EINVAL for a character cut short by the end of the data
+ * and to EILSEQ for an invalid byte sequence. */
+static size_t
+utf8_valid_prefix(const char *data, size_t size, int *error)
 {
-	return encoding_convert_string(encoding->cd, buf);
+	const unsigned char *bytes = (const unsigned char *) data;
+	size_t pos = 0;
+
+	*error = 0;
+
+	while (pos < size) {
+		size_t seqlen, i;
+		unsigned long word;
+
+		/* Skip ASCII a word at a time. */
+		if (pos + sizeof(word) <= size) {
+			memcpy(&word, bytes + pos, sizeof(word));
+			if (!(word & ((unsigned long) -1 / 0xff * 0x80))) {
+				pos += sizeof(word);
+				continue;
+			}
+		}
+
+		seqlen = bytes[pos] < 0x80 ? 1
+		       : bytes[pos] < 0xc2 ? 0
+		       : bytes[pos] < 0xe0 ? 2
+		       : bytes[pos] < 0xf0 ? 3
+		       : bytes[pos] < 0xf5 ? 4 : 0;
+
+		for (i = 1; i < seqlen && pos + i < size; i++)
+			if ((bytes[pos + i] & 0xc0) != 0x80)
+				break;
+
+		if (!seqlen || (i < seqlen && pos + i < size)) {
+			*error = EILSEQ;
+			break;
+		}
+		if (i < seqlen) {
+			*error = EINVAL;
+			break;
+		}
+		pos += seqlen;
+	}
+
+	return pos;
 }
 
 const char *
@@ -98,39 +149,6 @@ encoding_iconv(iconv_t iconv_cd, const char *string, size_t length)
 	return ret == instr ? string : ret;
 }
 
-struct encoding *
-get_path_encoding(const char *path, struct encoding *default_encoding)
-{
-	const char *check_attr_argv[] = {
-		"git", "check-attr", "encoding", "--", path, NULL
-	};
-	char buf[SIZEOF_STR];
-	char *encoding;
-
-	/* <path>: encoding: <encoding> */
-
-	if (!*path || !io_run_buf(check_attr_argv, buf, sizeof(buf), NULL, false)
-	    || !(encoding = strstr(buf, ENCODING_SEP)))
-		return default_encoding;
-
-	encoding += STRING_SIZE(ENCODING_SEP);
-	if (!strcmp(encoding, ENCODING_UTF8)
-	    || !strcmp(encoding, "unspecified")
-	    || !strcmp(encoding, "set")) {
-		const char *file_argv[] = {
-			"file", "-I", "--", path, NULL
-		};
-
-		if (!*path || !io_run_buf(file_argv, buf, sizeof(buf), NULL, false)
-		    || !(encoding = strstr(buf, CHARSET_SEP)))
-			return default_encoding;
-
-		encoding += STRING_SIZE(CHARSET_SEP);
-	}
-
-	return encoding_open(encoding);
-}
-
 /*
  * Path manipulation.
  */
@@ -203,16 +221,33 @@ io_kill(struct io *io)
 	return io->pid == 0 || kill(io->pid, SIGKILL) != -1;
 }
 
+static int io_merge_done(struct io *io);
+static void io_batch_release(struct io *io, bool done);
+static void io_trace_done(struct io_trace *trace, pid_t pid, int status, int error);
+
 bool
 io_done(struct io *io)
 {
+	struct io_trace *trace = io->trace;
 	pid_t pid = io->pid;
+	int status = io->status;
+	bool ok = true;
 
+	if (io->merge)
+		status = io_merge_done(io);
+	if (io->batch)
+		io_batch_release(io, false);
 	if (io->pipe != -1)
 		close(io->pipe);
 	free(io->buf);
+	free(io->raw);
 	io_init(io);
 
+	if (!pid && status) {
+		io->status = status;
+		ok = false;
+	}
+
 	while (pid > 0) {
 		int status = 0;
 		pid_t waiting = waitpid(pid, &status, 0);
@@ -221,17 +256,21 @@ io_done(struct io *io)
 			if (errno == EINTR)
 				continue;
 			io->error = errno;
-			return false;
+			ok = false;
+			break;
 		}
 
 		io->status = WIFEXITED(status) ? WEXITSTATUS(status) : 0;
 
-		return waiting == pid &&
-		       !WIFSIGNALED(status) &&
-		       !io->status;
+		ok = waiting == pid &&
+		     !WIFSIGNALED(status) &&
+		     !io->status;
+		break;
 	}
 
-	return true;
+	if (trace)
+		io_trace_done(trace, pid, io->status & 0xff, io->error);
+	return ok;
 }
 
 static int
@@ -292,18 +331,335 @@ io_trace(const char *fmt, ...)
 	return retval != -1;
 }
 
+/*
+ * Structured tracing.
+ *
+ * TIG_TRACE_JSON receives one JSON record per spawned command once it
+ * is done and TIG_TRACE_EVENTS a Chrome trace-event file with spans
+ * for commands and view updates. Times are in microseconds since the
+ * first traced event.
+ */
+
+struct io_trace {
+	char command[SIZEOF_STR];
+	const char *owner;	/* Name of the view reading the output. */
+	double start;		/* When the command was about to be spawned. */
+	double spawned;		/* When the command was running. */
+	double first_byte;	/* When output was first read, or -1. */
+	double eof;		/* When end of file was read, or -1. */
+	unsigned long long bytes;
+	unsigned long lines;
+};
+
+static FILE *trace_json;	/* Intensionally leaked. */
+static FILE *trace_events;	/* Intensionally leaked. */
+
+static bool
+io_trace_open(void)
+{
+	static bool opened;
+
+	if (!opened) {
+		const char *json_file = getenv("TIG_TRACE_JSON");
+		const char *events_file = getenv("TIG_TRACE_EVENTS");
+
+		opened = true;
+		if (json_file && *json_file)
+			trace_json = fopen(json_file, "a");
+		/* The closing bracket is optional in the trace-event format
+		 * so the file is usable even if tig is killed. */
+		if (events_file && *events_file &&
+		    (trace_events = fopen(events_file, "w")))
+			fputs("[\n", trace_events);
+	}
+
+	return trace_json || trace_events;
+}
+
+double
+io_trace_clock(void)
+{
+	static struct timespec origin;
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (!origin.tv_sec && !origin.tv_nsec)
+		origin = now;
+
+	return (now.tv_sec - origin.tv_sec) * 1e6 + (now.tv_nsec - origin.tv_nsec) / 1e3;
+}
+
+static void
+io_trace_string(FILE *file, const char *string)
+{
+	fputc('"', file);
+	for (; *string; string++) {
+		unsigned char c = *string;
+
+		if (c == '"' || c == '\\')
+			fprintf(file, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(file, "\\u%04x", c);
+		else
+			fputc(c, file);
+	}
+	fputc('"', file);
+}
+
+static void
+io_trace_event(const char *name, const char *category, double start, double end, pid_t tid)
+{
+	fputs("{\"name\":", trace_events);
+	io_trace_string(trace_events, name);
+	fprintf(trace_events, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.0f,\"dur\":%.0f,\"pid\":%d,\"tid\":%d",
+		category, start, end - start, (int) getpid(), (int) tid);
+}
+
+bool
+io_trace_spans(void)
+{
+	return io_trace_open() && trace_events;
+}
+
+void
+io_trace_span(const char *name, double start, double end, const char *fmt, ...)
+{
+	va_list args;
+
+	if (!io_trace_spans())
+		return;
+
+	io_trace_event(name, "view", start, end, getpid());
+	fputs(",\"args\":{", trace_events);
+	va_start(args, fmt);
+	vfprintf(trace_events, fmt, args);
+	va_end(args);
+	fputs("}},\n", trace_events);
+	fflush(trace_events);
+}
+
+static void
+io_trace_start(struct io *io, const char *argv[], double start)
+{
+	struct io_trace *trace = calloc(1, sizeof(*trace));
+	size_t bufpos = 0;
+	int i;
+
+	if (!trace)
+		return;
+
+	for (i = 0; argv[i]; i++)
+		if (!string_format_from(trace->command, &bufpos, "%s%s", i ? " " : "", argv[i]))
+			break;
+	trace->start = start;
+	trace->spawned = io_trace_clock();
+	trace->first_byte = trace->eof = -1;
+	io->trace = trace;
+}
+
+void
+io_trace_owner(struct io *io, const char *owner)
+{
+	if (io->trace)
+		io->trace->owner = owner;
+}
+
+static void
+io_trace_read(struct io *io, size_t size, bool eof)
+{
+	struct io_trace *trace = io->trace;
+
+	if (size && trace->first_byte < 0)
+		trace->first_byte = io_trace_clock();
+	if (eof && trace->eof < 0)
+		trace->eof = io_trace_clock();
+	trace->bytes += size;
+}
+
+static void
+io_trace_time(FILE *file, const char *name, struct io_trace *trace, double time)
+{
+	if (time < 0)
+		fprintf(file, ",\"%s\":null", name);
+	else
+		fprintf(file, ",\"%s\":%.0f", name, time - trace->start);
+}
+
+static void
+io_trace_done(struct io_trace *trace, pid_t pid, int status, int error)
+{
+	double done = io_trace_clock();
+
+	if (trace_json) {
+		fputs("{\"command\":", trace_json);
+		io_trace_string(trace_json, trace->command);
+		fputs(",\"view\":", trace_json);
+		if (trace->owner)
+			io_trace_string(trace_json, trace->owner);
+		else
+			fputs("null", trace_json);
+		fprintf(trace_json, ",\"pid\":%d,\"start\":%.0f", (int) pid, trace->start);
+		io_trace_time(trace_json, "spawn", trace, trace->spawned);
+		io_trace_time(trace_json, "first_byte", trace, trace->first_byte);
+		io_trace_time(trace_json, "eof", trace, trace->eof);
+		io_trace_time(trace_json, "done", trace, done);
+		fprintf(trace_json, ",\"bytes\":%llu,\"lines\":%lu,\"status\":%d,\"error\":",
+			trace->bytes, trace->lines, status);
+		if (error)
+			io_trace_string(trace_json, strerror(error));
+		else
+			fputs("null", trace_json);
+		fputs("}\n", trace_json);
+		fflush(trace_json);
+	}
+
+	if (trace_events) {
+		io_trace_event(trace->command, "io", trace->start, done, pid > 0 ? pid : getpid());
+		fputs(",\"args\":{\"view\":", trace_events);
+		io_trace_string(trace_events, trace->owner ? trace->owner : "");
+		fprintf(trace_events, ",\"bytes\":%llu,\"lines\":%lu,\"status\":%d}},\n",
+			trace->bytes, trace->lines, status);
+		fflush(trace_events);
+	}
+
+	free(trace);
+}
+
+extern char **environ;
+
+static bool
+env_name_equal(const char *a, const char *b)
+{
+	size_t namelen = strcspn(a, "=");
+
+	return !strncmp(a, b, namelen + 1) && a[namelen] == '=';
+}
+
+/* Merge the custom variables into the current environment like
+ * putenv() does, with later variables overriding earlier ones. */
+static char **
+io_exec_env(char * const env[])
+{
+	size_t size = 1, envc = 0;
+	char **envp;
+	int i, j;
+
+	for (i = 0; environ[i]; i++)
+		size++;
+	for (i = 0; env[i]; i++)
+		size++;
+
+	envp = calloc(size, sizeof(*envp));
+	if (!envp)
+		return NULL;
+
+	for (i = 0; environ[i]; i++) {
+		for (j = 0; env[j]; j++)
+			if (*env[j] && env_name_equal(env[j], environ[i]))
+				break;
+		if (!env[j])
+			envp[envc++] = environ[i];
+	}
+
+	for (i = 0; env[i]; i++) {
+		if (!*env[i])
+			continue;
+		for (j = i + 1; env[j]; j++)
+			if (*env[j] && env_name_equal(env[j], env[i]))
+				break;
+		if (!env[j])
+			envp[envc++] = env[i];
+	}
+
+	return envp;
+}
+
+static int
+io_exec_close(posix_spawn_file_actions_t *actions, int fd)
+{
+	if (fd <= STDERR_FILENO)
+		return 0;
+	return posix_spawn_file_actions_addclose(actions, fd);
+}
+
+#ifdef NO_POSIX_SPAWN_CHDIR
+/* Without support for changing directory in the file actions the
+ * directory is changed around the spawn call. */
+static int
+io_spawn(pid_t *pid, const char *dir, const char *argv[],
+	 posix_spawn_file_actions_t *actions, char **envp)
+{
+	int cwd = -1;
+	int error;
+
+	if (dir && *dir) {
+		cwd = open(".", O_RDONLY);
+		if (cwd == -1 || chdir(dir) == -1) {
+			error = errno;
+			if (cwd != -1)
+				close(cwd);
+			return error;
+		}
+	}
+
+	error = posix_spawnp(pid, argv[0], actions, NULL, (char *const*) argv, envp);
+
+	if (cwd != -1) {
+		if (fchdir(cwd) == -1 && !error)
+			error = errno;
+		close(cwd);
+	}
+
+	return error;
+}
+#else
+static int
+io_spawn(pid_t *pid, const char *dir, const char *argv[],
+	 posix_spawn_file_actions_t *actions, char **envp)
+{
+	int error = 0;
+
+	if (dir && *dir)
+		error = posix_spawn_file_actions_addchdir_np(actions, dir);
+	if (!error)
+		error = posix_spawnp(pid, argv[0], actions, NULL, (char *const*) argv, envp);
+
+	return error;
+}
+#endif
+
+static bool is_cat_file_blob(const char *argv[]);
+static bool io_cat_file_blob(struct io *io, enum io_type type, const char *argv[], int fd);
+
 bool
 io_exec(struct io *io, enum io_type type, const char *dir, char * const env[], const char *argv[], int custom)
 {
+	posix_spawn_file_actions_t actions;
 	int pipefds[2] = { -1, -1 };
+	int devnull = -1, errorfd = -1;
 	bool read_from_stdin = type == IO_RD && (custom & IO_RD_FORWARD_STDIN);
 	bool read_with_stderr = type == IO_RD && (custom & IO_RD_WITH_STDERR);
+	char **envp = environ;
+	bool trace = io_trace_open();
+	double start = trace ? io_trace_clock() : 0;
+	int error;
 
 	io_init(io);
 
 	if (dir && !strcmp(dir, argv[0]))
 		return io_open(io, "%s%s", dir, argv[1]);
 
+	if (is_cat_file_blob(argv) && (type == IO_RD || type == IO_AP)) {
+		if (!io_cat_file_blob(io, type, argv, custom))
+			return false;
+		if (trace) {
+			io_trace_start(io, argv, start);
+			if (io->trace && io_eof(io))
+				io_trace_read(io, io->bufsize, true);
+		}
+		return true;
+	}
+
 	if ((type == IO_RD || type == IO_RP || type == IO_WR) && pipe(pipefds) < 0) {
 		io->error = errno;
 		return false;
@@ -311,63 +667,72 @@ io_exec(struct io *io, enum io_type type, const char *dir, char * const env[], c
 		pipefds[1] = custom;
 	}
 
-	if ((io->pid = fork())) {
-		if (io->pid == -1)
-			io->error = errno;
-		if (pipefds[!(type == IO_WR)] != -1)
-			close(pipefds[!(type == IO_WR)]);
-		if (io->pid != -1) {
-			io->pipe = pipefds[!!(type == IO_WR)];
-			return true;
-		}
-
-	} else {
-		if (type != IO_FG) {
-			int devnull = open("/dev/null", O_RDWR);
-			int readfd  = type == IO_WR ? pipefds[0]
-				    : type == IO_RP ? custom
-				    : devnull;
-			int writefd = (type == IO_RD || type == IO_RP || type == IO_AP)
-				    ? pipefds[1] : devnull;
-			int errorfd = open_trace(devnull, argv);
-
-			/* Inject stdin given on the command line. */
-			if (read_from_stdin)
-				readfd = dup(STDIN_FILENO);
-
-			dup2(readfd,  STDIN_FILENO);
-			dup2(writefd, STDOUT_FILENO);
-			if (read_with_stderr)
-				dup2(writefd, STDERR_FILENO);
-			else
-				dup2(errorfd, STDERR_FILENO);
-
-			if (devnull != errorfd)
-				close(errorfd);
-			close(devnull);
-			if (pipefds[0] != -1)
-				close(pipefds[0]);
-			if (pipefds[1] != -1)
-				close(pipefds[1]);
-		}
-
-		if (dir && *dir && chdir(dir) == -1)
-			_exit(errno);
-
-		if (env) {
-			int i;
-
-			for (i = 0; env[i]; i++)
-				if (*env[i])
-					putenv(env[i]);
-		}
+	error = posix_spawn_file_actions_init(&actions);
+
+	if (!error && type != IO_FG) {
+		int readfd, writefd;
+
+		devnull = open("/dev/null", O_RDWR);
+		readfd  = type == IO_WR ? pipefds[0]
+			: type == IO_RP ? custom
+			: devnull;
+		writefd = (type == IO_RD || type == IO_RP || type == IO_AP)
+			? pipefds[1] : devnull;
+		errorfd = open_trace(devnull, argv);
+
+		/* Inject stdin given on the command line. */
+		if (read_from_stdin)
+			readfd = STDIN_FILENO;
+
+		if (readfd != STDIN_FILENO)
+			error = posix_spawn_file_actions_adddup2(&actions, readfd, STDIN_FILENO);
+		if (!error)
+			error = posix_spawn_file_actions_adddup2(&actions, writefd, STDOUT_FILENO);
+		if (!error)
+			error = posix_spawn_file_actions_adddup2(&actions,
+					read_with_stderr ? writefd : errorfd, STDERR_FILENO);
+
+		if (!error && devnull != errorfd)
+			error = io_exec_close(&actions, errorfd);
+		if (!error)
+			error = io_exec_close(&actions, devnull);
+		if (!error)
+			error = io_exec_close(&actions, pipefds[0]);
+		if (!error)
+			error = io_exec_close(&actions, pipefds[1]);
+	}
 
-		execvp(argv[0], (char *const*) argv);
+	if (!error && env) {
+		envp = io_exec_env(env);
+		if (!envp)
+			error = ENOMEM;
+	}
 
-		close(STDOUT_FILENO);
-		_exit(errno);
+	/* Report failing to run the command through the exit status, same
+	 * as when the exec in a forked child fails. */
+	if (!error && (io->status = io_spawn(&io->pid, dir, argv, &actions, envp)))
+		io->pid = 0;
+
+	posix_spawn_file_actions_destroy(&actions);
+	if (envp && envp != environ)
+		free(envp);
+	if (errorfd != -1 && errorfd != devnull)
+		close(errorfd);
+	if (devnull != -1)
+		close(devnull);
+
+	if (pipefds[!(type == IO_WR)] != -1)
+		close(pipefds[!(type == IO_WR)]);
+
+	if (!error) {
+		io->pipe = pipefds[!!(type == IO_WR)];
+		if (trace)
+			io_trace_start(io, argv, start);
+		return true;
 	}
 
+	io->pid = 0;
+	io->error = error;
 	if (pipefds[!!(type == IO_WR)] != -1)
 		close(pipefds[!!(type == IO_WR)]);
 	return false;
@@ -423,21 +788,31 @@ io_strerror(struct io *io)
 	return strerror(io->error);
 }
 
-bool
-io_can_read(struct io *io, bool can_block)
+static bool
+io_can_read_fd(int fd, bool can_block)
 {
-	struct timeval tv = { 0, 500 };
-	fd_set fds;
+	struct pollfd pfd = { fd, POLLIN };
 
-	FD_ZERO(&fds);
-	FD_SET(io->pipe, &fds);
+	return poll(&pfd, 1, can_block ? -1 : 0) > 0;
+}
 
-	return select(io->pipe + 1, &fds, NULL, NULL, can_block ? NULL : &tv) > 0;
+bool
+io_can_read(struct io *io, bool can_block)
+{
+	/* Content read into memory up front is always available. */
+	if (io->pipe == -1)
+		return true;
+	return io_can_read_fd(io->pipe, can_block);
 }
 
+static ssize_t io_batch_read(struct io *io, void *buf, size_t bufsize);
+
 ssize_t
 io_read(struct io *io, void *buf, size_t bufsize)
 {
+	if (io->batch)
+		return io_batch_read(io, buf, bufsize);
+
 	do {
 		ssize_t readsize = read(io->pipe, buf, bufsize);
 
@@ -447,6 +822,8 @@ io_read(struct io *io, void *buf, size_t bufsize)
 			io->error = errno;
 		else if (readsize == 0)
 			io->eof = 1;
+		if (io->trace && readsize >= 0)
+			io_trace_read(io, readsize, !readsize);
 		return readsize;
 	} while (1);
 }
@@ -463,13 +840,392 @@ io_memchr(struct buffer *buf, char *data, int c)
 	return pos ? pos + 1 : NULL;
 }
 
-DEFINE_ALLOCATOR(io_realloc_buf, char, BUFSIZ)
+/*
+ * The read buffer starts out at IO_BUF_SIZE bytes and is doubled whenever a
+ * line does not fit. Reads are limited to IO_READ_MAX bytes so that a view
+ * gets a chance to process and draw what has been read so far.
+ */
+#ifndef IO_BUF_SIZE
+#define IO_BUF_SIZE	(64 * 1024)
+#endif
+
+#ifndef IO_READ_MAX
+#define IO_READ_MAX	(1024 * 1024)
+#endif
+
+static bool
+io_realloc_buf(struct io *io, size_t size)
+{
+	size_t offset = io->bufpos - io->buf;
+	char *tmp = realloc(io->buf, size);
+
+	if (!tmp)
+		return false;
+
+	io->buf = tmp;
+	io->bufpos = tmp + offset;
+	io->bufalloc = size;
+	return true;
+}
+
+/* Make room for reading more data after the buffered content. Always keeps
+ * one byte in reserve for terminating the last line at end of file. */
+static size_t
+io_reserve_buf(struct io *io)
+{
+	size_t offset = io->bufpos - io->buf;
+	size_t avail = io->bufalloc - offset - io->bufsize;
+
+	if (!io->bufsize) {
+		io->bufpos = io->buf;
+		avail += offset;
+		offset = 0;
+	}
+
+	/* Only compact when the free space at the end has become small,
+	 * so the unfinished line is moved at most once per buffer fill. */
+	if (offset && avail < io->bufalloc / 4) {
+		memmove(io->buf, io->bufpos, io->bufsize);
+		io->bufpos = io->buf;
+		avail += offset;
+	}
+
+	if (avail <= 1 || avail < io->bufalloc / 4) {
+		size_t size = io->bufalloc ? io->bufalloc * 2 : IO_BUF_SIZE;
+
+		if (!io_realloc_buf(io, size))
+			return 0;
+		avail = io->bufalloc - (io->bufpos - io->buf) - io->bufsize;
+	}
+
+	return MIN(avail - 1, IO_READ_MAX);
+}
+
+/*
+ * Input conversion.
+ *
+ * Input read in a different encoding is converted a chunk at a time into
+ * the line buffer. Bytes of a character cut short by the end of a chunk
+ * are kept in the raw buffer until the rest is read.
+ */
+
+static bool
+io_reserve_raw(struct io *io, size_t size)
+{
+	if (io->rawalloc - io->rawsize < size) {
+		size_t alloc = MAX(io->rawalloc * 2, io->rawsize + size);
+		char *tmp = realloc(io->raw, alloc);
+
+		if (!tmp)
+			return false;
+		io->raw = tmp;
+		io->rawalloc = alloc;
+	}
+
+	return true;
+}
+
+static bool
+io_convert(struct io *io)
+{
+	struct encoding *encoding = io->encoding;
+	ICONV_CONST char *in = io->raw;
+	size_t inlen = io->rawsize;
+
+	while (inlen > 0) {
+		size_t avail = io_reserve_buf(io);
+		char *out = io->bufpos + io->bufsize;
+		size_t outlen = avail;
+		int error = 0;
+
+		if (!avail) {
+			io->error = ENOMEM;
+			return false;
+		}
+
+		if (encoding->utf8) {
+			/* Valid input needs no conversion. */
+			size_t size = MIN(inlen, outlen);
+			size_t valid = utf8_valid_prefix(in, size, &error);
+
+			memcpy(out, in, valid);
+			in += valid, inlen -= valid;
+			out += valid, outlen -= valid;
+			if (error == EINVAL && size < inlen + valid)
+				error = E2BIG;
+			else if (!error && inlen)
+				error = E2BIG;
+
+		} else if (iconv(encoding->cd, &in, &inlen, &out, &outlen) == (size_t) -1) {
+			error = errno;
+			if (error != E2BIG && error != EINVAL && error != EILSEQ) {
+				io->error = error;
+				return false;
+			}
+		}
+
+		io->bufsize += avail - outlen;
+
+		/* Incomplete input is kept until more is read. */
+		if (error == EINVAL && !io->eof)
+			break;
+
+		/* Replace invalid input instead of failing the whole view. */
+		if ((error == EINVAL || error == EILSEQ) && outlen) {
+			io->bufpos[io->bufsize++] = '?';
+			in++, inlen--;
+		}
+	}
+
+	memmove(io->raw, in, inlen);
+	io->rawsize = inlen;
+	return true;
+}
+
+static bool
+io_read_converted(struct io *io)
+{
+	ssize_t readsize;
+
+	if (!io_reserve_raw(io, IO_BUF_SIZE))
+		return false;
+
+	readsize = io_read(io, io->raw + io->rawsize, io->rawalloc - io->rawsize);
+	if (io_error(io))
+		return false;
+
+	io->rawsize += readsize;
+	return io_convert(io);
+}
+
+void
+io_set_encoding(struct io *io, struct encoding *encoding)
+{
+	if (encoding)
+		iconv(encoding->cd, NULL, NULL, NULL, NULL);
+
+	io->encoding = encoding;
+
+	/* Convert content which has already been read. */
+	if (encoding && io->bufsize && io_reserve_raw(io, io->bufsize)) {
+		memcpy(io->raw + io->rawsize, io->bufpos, io->bufsize);
+		io->rawsize += io->bufsize;
+		io->bufpos = io->buf;
+		io->bufsize = 0;
+		io_convert(io);
+	}
+}
+
+/*
+ * Merging the output of concurrent commands.
+ *
+ * A thread reads the output of several commands and writes it to a
+ * single pipe one record at a time so records from different commands
+ * are never interleaved. A record ends with a line starting with a
+ * given prefix.
+ */
+
+struct io_merge_input {
+	struct io io;
+	size_t scanned;		/* Bytes already checked for record ends. */
+	size_t records;		/* Bytes of complete records. */
+};
+
+struct io_merge {
+	pthread_t thread;
+	int fd;			/* Write end of the merged pipe. */
+	int stop[2];		/* Asks the merge thread to stop. */
+	const char *record_end;
+	size_t inputs_count;
+	struct io_merge_input inputs[1];
+};
+
+static void
+io_merge_scan(struct io_merge *merge, struct io_merge_input *input)
+{
+	struct io *io = &input->io;
+	size_t prefixlen = strlen(merge->record_end);
+	char *pos = io->buf + input->scanned;
+	char *end = io->buf + io->bufsize;
+	char *eol;
+
+	while ((eol = memchr(pos, '\n', end - pos))) {
+		if (eol - pos >= prefixlen && !memcmp(pos, merge->record_end, prefixlen))
+			input->records = eol + 1 - io->buf;
+		pos = eol + 1;
+	}
+
+	input->scanned = pos - io->buf;
+}
+
+static bool
+io_merge_write(struct io_merge *merge, struct io_merge_input *input, size_t size)
+{
+	struct io *io = &input->io;
+	struct io out = { merge->fd };
+
+	if (!io_write(&out, io->buf, size))
+		return false;
+
+	memmove(io->buf, io->buf + size, io->bufsize - size);
+	io->bufsize -= size;
+	input->scanned -= size;
+	input->records = 0;
+	return true;
+}
+
+static void *
+io_merge_run(void *data)
+{
+	struct io_merge *merge = data;
+	struct pollfd *fds = calloc(merge->inputs_count + 1, sizeof(*fds));
+	size_t running = merge->inputs_count;
+	size_t i;
+
+	if (!fds)
+		goto done;
+
+	fds[0].fd = merge->stop[0];
+	fds[0].events = POLLIN;
+	for (i = 0; i < merge->inputs_count; i++) {
+		fds[i + 1].fd = merge->inputs[i].io.pipe;
+		fds[i + 1].events = POLLIN;
+	}
+
+	while (running) {
+		if (poll(fds, merge->inputs_count + 1, -1) < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			break;
+		}
+
+		if (fds[0].revents)
+			break;
+
+		for (i = 0; i < merge->inputs_count; i++) {
+			struct io_merge_input *input = &merge->inputs[i];
+			struct io *io = &input->io;
+			ssize_t readsize;
+
+			if (!fds[i + 1].revents)
+				continue;
+
+			if (io->bufalloc - io->bufsize < BUFSIZ &&
+			    !io_realloc_buf(io, io->bufalloc ? io->bufalloc * 2 : BUFSIZ * 4))
+				goto done;
+
+			readsize = io_read(io, io->buf + io->bufsize, io->bufalloc - io->bufsize);
+			if (readsize > 0) {
+				io->bufsize += readsize;
+				io_merge_scan(merge, input);
+				if (input->records && !io_merge_write(merge, input, input->records))
+					goto done;
+				continue;
+			}
+
+			/* Pass on anything left over after the last record. */
+			if (io->bufsize && !io_merge_write(merge, input, io->bufsize))
+				goto done;
+			fds[i + 1].fd = -1;
+			running--;
+		}
+	}
+
+done:
+	free(fds);
+	close(merge->fd);
+	return NULL;
+}
+
+/* Read the merged output of the commands of the given ios, which are
+ * taken over by @io and finished when it is done. */
+bool
+io_merge(struct io *io, struct io inputs[], size_t inputs_count, const char *record_end)
+{
+	struct io_merge *merge;
+	int pipefds[2];
+	size_t i;
+
+	io_init(io);
+
+	merge = calloc(1, sizeof(*merge) + (inputs_count - 1) * sizeof(*merge->inputs));
+	if (!merge || pipe(pipefds) < 0) {
+		io->error = errno;
+		for (i = 0; i < inputs_count; i++) {
+			io_kill(&inputs[i]);
+			io_done(&inputs[i]);
+		}
+		free(merge);
+		return false;
+	}
+
+	merge->fd = pipefds[1];
+	merge->record_end = record_end;
+	merge->inputs_count = inputs_count;
+	for (i = 0; i < inputs_count; i++)
+		merge->inputs[i].io = inputs[i];
+
+	if (pipe(merge->stop) < 0) {
+		io->error = errno;
+	} else if ((errno = pthread_create(&merge->thread, NULL, io_merge_run, merge))) {
+		io->error = errno;
+		close(merge->stop[0]);
+		close(merge->stop[1]);
+	}
+
+	if (io->error) {
+		close(pipefds[0]);
+		close(pipefds[1]);
+		for (i = 0; i < inputs_count; i++) {
+			io_kill(&merge->inputs[i].io);
+			io_done(&merge->inputs[i].io);
+		}
+		free(merge);
+		return false;
+	}
+
+	io->pipe = pipefds[0];
+	io->merge = merge;
+	return true;
+}
+
+/* Stop the merge thread, killing commands which are still running, and
+ * return the first non-zero exit status. */
+static int
+io_merge_done(struct io *io)
+{
+	struct io_merge *merge = io->merge;
+	int status = 0;
+	size_t i;
+
+	/* Closing the read end unblocks the thread if it is writing. */
+	close(io->pipe);
+	io->pipe = -1;
+	if (write(merge->stop[1], "", 1) < 0)
+		io->error = errno;
+	pthread_join(merge->thread, NULL);
+
+	for (i = 0; i < merge->inputs_count; i++) {
+		struct io *input = &merge->inputs[i].io;
+
+		if (!input->eof)
+			io_kill(input);
+		if (!io_done(input) && !status)
+			status = input->status ? input->status : -1;
+	}
+
+	close(merge->stop[0]);
+	close(merge->stop[1]);
+	free(merge);
+	return status;
+}
 
 static bool
 io_get_line(struct io *io, struct buffer *buf, int c, size_t *lineno, bool can_read, char eol_char)
 {
 	char *eol;
 	ssize_t readsize;
+	size_t readmax;
 
 	while (true) {
 		if (io->bufsize > 0) {
@@ -512,17 +1268,17 @@ io_get_line(struct io *io, struct buffer *buf, int c, size_t *lineno, bool can_r
 		if (!can_read)
 			return false;
 
-		if (io->bufsize > 0 && io->bufpos > io->buf)
-			memmove(io->buf, io->bufpos, io->bufsize);
-
-		if (io->bufalloc == io->bufsize) {
-			if (!io_realloc_buf(&io->buf, io->bufalloc, BUFSIZ))
+		if (io->encoding) {
+			if (!io_read_converted(io))
 				return false;
-			io->bufalloc += BUFSIZ;
+			continue;
 		}
 
-		io->bufpos = io->buf;
-		readsize = io_read(io, io->buf + io->bufsize, io->bufalloc - io->bufsize);
+		readmax = io_reserve_buf(io);
+		if (!readmax)
+			return false;
+
+		readsize = io_read(io, io->bufpos + io->bufsize, readmax);
 		if (io_error(io))
 			return NULL;
 		io->bufsize += readsize;
@@ -532,7 +1288,11 @@ io_get_line(struct io *io, struct buffer *buf, int c, size_t *lineno, bool can_r
 bool
 io_get(struct io *io, struct buffer *buf, int c, bool can_read)
 {
-	return io_get_line(io, buf, c, NULL, can_read, 0);
+	bool ok = io_get_line(io, buf, c, NULL, can_read, 0);
+
+	if (ok && io->trace)
+		io->trace->lines++;
+	return ok;
 }
 
 bool
@@ -592,6 +1352,498 @@ io_run_buf(const char **argv, char buf[], size_t bufsize, const char *dir, bool
 	return io_run(&io, IO_RD, dir, NULL, argv) && io_read_buf(&io, buf, bufsize, allow_empty);
 }
 
+/*
+ * Long running Git commands serving requests read from stdin.
+ */
+
+struct io_batch {
+	const char **argv;
+	struct io requests;
+	struct io replies;
+	char * const *env;
+	bool busy;		/* Is a reply still being read? */
+};
+
+static void
+io_batch_stop(struct io_batch *batch)
+{
+	io_done(&batch->requests);
+	io_done(&batch->replies);
+}
+
+static bool
+io_batch_start(struct io_batch *batch)
+{
+	int pipefds[2];
+
+	if (batch->requests.pipe != -1)
+		return true;
+
+	if (pipe(pipefds) < 0)
+		return false;
+
+	/* Keep other commands from holding on to the batch pipes. */
+	fcntl(pipefds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(pipefds[1], F_SETFD, FD_CLOEXEC);
+
+	if (!io_exec(&batch->replies, IO_RP, NULL, batch->env, batch->argv, pipefds[0])) {
+		close(pipefds[0]);
+		close(pipefds[1]);
+		return false;
+	}
+
+	fcntl(batch->replies.pipe, F_SETFD, FD_CLOEXEC);
+	close(pipefds[0]);
+	io_init(&batch->requests);
+	batch->requests.pipe = pipefds[1];
+	return true;
+}
+
+/* Stop reading a reply. A reply which was not read to the end leaves
+ * the batch process out of step, so it is restarted for the next one. */
+static void
+io_batch_release(struct io *io, bool done)
+{
+	struct io_batch *batch = io->batch;
+
+	if (!done)
+		io_batch_stop(batch);
+	batch->busy = false;
+	io->batch = NULL;
+	io->pipe = -1;
+}
+
+/* Read the content of a reply, first from what has already been
+ * buffered while reading the reply header, then from the batch pipe. */
+static ssize_t
+io_batch_read(struct io *io, void *buf, size_t bufsize)
+{
+	struct io *replies = &io->batch->replies;
+	ssize_t readsize;
+
+	bufsize = MIN(bufsize, io->batch_left);
+	if (replies->bufsize) {
+		readsize = MIN(bufsize, replies->bufsize);
+		memcpy(buf, replies->bufpos, readsize);
+		replies->bufpos += readsize;
+		replies->bufsize -= readsize;
+	} else {
+		readsize = io_read(replies, buf, bufsize);
+	}
+
+	if (readsize <= 0) {
+		io->error = replies->error ? replies->error : EIO;
+		io_batch_release(io, false);
+		return -1;
+	}
+
+	io->batch_left -= readsize;
+	if (!io->batch_left) {
+		/* Drop the newline ending the reply. */
+		readsize--;
+		io_batch_release(io, true);
+		io->eof = 1;
+	}
+
+	if (io->trace)
+		io_trace_read(io, readsize, io->eof);
+	return readsize;
+}
+
+/*
+ * Blob content is read through one long running git-cat-file --batch
+ * process instead of starting a new process for every blob.
+ */
+
+static const char *cat_file_argv[] = { "git", "cat-file", "--batch", NULL };
+static struct io_batch cat_file_batch = { cat_file_argv, { -1 }, { -1 } };
+
+/* While a blob is still being read the batch process is busy, and a
+ * new process is started for other blobs. */
+static bool
+is_cat_file_blob(const char *argv[])
+{
+	return !cat_file_batch.busy &&
+	       argv[0] && !strcmp(argv[0], "git") &&
+	       argv[1] && !strcmp(argv[1], "cat-file") &&
+	       argv[2] && !strcmp(argv[2], "blob") &&
+	       argv[3] && !argv[4] && !strchr(argv[3], '\n');
+}
+
+/* Request an object and parse the "<id> <type> <size>" reply header,
+ * restarting the batch process once if it has gone away. Returns the
+ * object size or -1 if the object could not be found. */
+static ssize_t
+io_cat_file_request(const char *object, bool *is_blob)
+{
+	int retries;
+
+	for (retries = 0; retries < 2; retries++) {
+		struct buffer header;
+		char *type, *size;
+		size_t idlen;
+
+		if (!io_batch_start(&cat_file_batch))
+			return -1;
+
+		if (!io_printf(&cat_file_batch.requests, "%s\n", object) ||
+		    !io_get(&cat_file_batch.replies, &header, '\n', true)) {
+			io_batch_stop(&cat_file_batch);
+			continue;
+		}
+
+		/* Unknown objects are reported as "<object> missing". */
+		idlen = strspn(header.data, "0123456789abcdef");
+		type = header.data + idlen;
+		size = strrchr(type, ' ');
+		if (idlen < SIZEOF_REV - 1 || *type != ' ' || size == type ||
+		    !isdigit((unsigned char) size[1]))
+			return -1;
+
+		*is_blob = !strncmp(type, " blob ", STRING_SIZE(" blob "));
+		return strtoul(size + 1, NULL, 10);
+	}
+
+	return -1;
+}
+
+/* Copy the blob to the file being appended to. */
+static bool
+io_cat_file_append(struct io *io, int fd)
+{
+	struct io out = { fd };
+	char buf[BUFSIZ];
+	bool ok = true;
+
+	while (ok && !io_eof(io)) {
+		ssize_t readsize = io_read(io, buf, sizeof(buf));
+
+		ok = readsize >= 0 && io_write(&out, buf, readsize);
+	}
+
+	if (!ok && !io->error)
+		io->error = out.error;
+	return ok;
+}
+
+/* The blob is read from the batch pipe as it arrives, so a view shows
+ * the content while it is loading and can stop reading a large blob. */
+static bool
+io_cat_file_blob(struct io *io, enum io_type type, const char *argv[], int fd)
+{
+	struct io *replies = &cat_file_batch.replies;
+	int tracefd = open_trace(-1, argv);
+	bool is_blob = false;
+	bool ok = true;
+	ssize_t size;
+
+	if (tracefd != -1)
+		close(tracefd);
+
+	size = io_cat_file_request(argv[3], &is_blob);
+	if (size < 0) {
+		io->error = ENOENT;
+		ok = false;
+
+	} else if (!is_blob) {
+		/* Restart rather than read content which is not shown. */
+		io_batch_stop(&cat_file_batch);
+		io->error = EINVAL;
+		ok = false;
+
+	} else {
+		cat_file_batch.busy = true;
+		io->batch = &cat_file_batch;
+		io->batch_left = size + 1;
+		io->pipe = replies->pipe;
+
+		if (type == IO_AP) {
+			ok = io_cat_file_append(io, fd);
+
+		} else if (replies->bufsize >= io->batch_left) {
+			/* Nothing more will arrive on the pipe. */
+			if (!io_realloc_buf(io, io->batch_left)) {
+				io->error = ENOMEM;
+				ok = false;
+			} else {
+				io->bufsize = io_read(io, io->buf, io->batch_left);
+			}
+		}
+
+		if (!ok && io->batch)
+			io_batch_release(io, false);
+	}
+
+	if (type == IO_AP)
+		close(fd);
+	return ok;
+}
+
+/*
+ * Object sizes are looked up through a long running git-cat-file
+ * --batch-check. Lazy fetching is disabled so a partial clone does not
+ * download objects only to show their size.
+ */
+
+static const char *cat_file_check_argv[] = { "git", "cat-file", "--batch-check", NULL };
+static char * const cat_file_check_env[] = { "GIT_NO_LAZY_FETCH=1", NULL };
+static struct io_batch cat_file_check_batch = {
+	cat_file_check_argv, { -1 }, { -1 }, cat_file_check_env
+};
+static size_t cat_file_check_pending;
+
+#define IO_OBJECT_SIZES_PENDING	1024
+
+/* Send requests for the sizes of objects without waiting for the
+ * replies. At most IO_OBJECT_SIZES_PENDING replies are left unread so
+ * that neither side blocks on a full pipe. */
+bool
+io_object_sizes_request(const char *ids[], size_t count)
+{
+	size_t i;
+
+	if (cat_file_check_pending + count > IO_OBJECT_SIZES_PENDING)
+		return false;
+
+	if (!io_batch_start(&cat_file_check_batch))
+		return false;
+
+	for (i = 0; i < count; i++) {
+		if (!io_printf(&cat_file_check_batch.requests, "%s\n", ids[i])) {
+			io_batch_stop(&cat_file_check_batch);
+			cat_file_check_pending = 0;
+			return false;
+		}
+		cat_file_check_pending++;
+	}
+
+	return true;
+}
+
+/* Read the replies to requested sizes in the order they were requested.
+ * Objects which could not be found have found[i] set to false. Returns
+ * the number of replies read, which without blocking may be less than
+ * count, or -1 if the requests have failed. */
+ssize_t
+io_object_sizes_read(unsigned long sizes[], bool found[], size_t count, bool can_block)
+{
+	struct io *replies = &cat_file_check_batch.replies;
+	bool can_read = can_block || io_can_read(replies, false);
+	size_t i;
+
+	count = MIN(count, cat_file_check_pending);
+
+	/* Replies are "<id> <type> <size>" or "<object> missing". */
+	for (i = 0; i < count; i++, can_read = can_block) {
+		struct buffer reply;
+		char *size;
+
+		if (!io_get(replies, &reply, '\n', can_read)) {
+			if (!io_eof(replies) && !io_error(replies))
+				break;
+			io_batch_stop(&cat_file_check_batch);
+			cat_file_check_pending = 0;
+			return -1;
+		}
+
+		size = strrchr(reply.data, ' ');
+		found[i] = size && isdigit((unsigned char) size[1]);
+		if (found[i])
+			sizes[i] = strtoul(size + 1, NULL, 10);
+		cat_file_check_pending--;
+	}
+
+	return i;
+}
+
+/* The pipe to wait on for replies to requested sizes. */
+struct io *
+io_object_sizes_pipe(void)
+{
+	return cat_file_check_pending ? &cat_file_check_batch.replies : NULL;
+}
+
+/*
+ * Path encoding detection.
+ *
+ * The encoding attribute is looked up through a long running
+ * git-check-attr and the charset of files without one is detected
+ * in-process. Results are cached per path until the file or any
+ * .gitattributes which may apply to it changes.
+ */
+
+struct path_encoding {
+	struct encoding *encoding;
+	unsigned long signature;
+	char path[1];
+};
+
+DEFINE_STRING_MAP(path_encodings, struct path_encoding *, path, 32)
+
+static const char *check_attr_argv[] = { "git", "check-attr", "--stdin", "-z", "encoding", NULL };
+static struct io_batch check_attr_batch = { check_attr_argv, { -1 }, { -1 } };
+
+static unsigned long
+stat_signature(unsigned long signature, const char *path)
+{
+	struct stat st;
+
+	signature *= 31;
+	if (stat(path, &st) == 0)
+		signature = ((signature + st.st_mtime) * 31 + st.st_size) * 31 + st.st_ino;
+	return signature;
+}
+
+/* The file itself is only checked when its charset is detected. */
+static unsigned long
+path_encoding_signature(const char *path)
+{
+	static int cwd_depth = -1;
+	unsigned long signature = default_encoding ? 0 : stat_signature(0, path);
+	char attributes[SIZEOF_STR];
+	char updir[SIZEOF_STR] = "";
+	size_t updirlen = 0;
+	const char *sep;
+	int depth;
+
+	/* Attributes in directories leading to the file ... */
+	for (sep = path; (sep = strchr(sep, '/')); sep++)
+		if (string_format(attributes, "%.*s/.gitattributes", (int) (sep - path), path))
+			signature = stat_signature(signature, attributes);
+
+	if (cwd_depth < 0) {
+		char cwd[SIZEOF_STR];
+
+		cwd_depth = 0;
+		if (getcwd(cwd, sizeof(cwd)))
+			for (sep = cwd; (sep = strchr(sep + 1, '/')); )
+				cwd_depth++;
+	}
+
+	/* ... and in the working directory up to the top-level. */
+	for (depth = 0; depth <= cwd_depth; depth++) {
+		struct stat st;
+
+		if (depth && !string_format_from(updir, &updirlen, "../"))
+			break;
+		if (string_format(attributes, "%s.gitattributes", updir))
+			signature = stat_signature(signature, attributes);
+
+		if (string_format(attributes, "%s.git", updir) && !lstat(attributes, &st)) {
+			if (S_ISDIR(st.st_mode) &&
+			    string_format(attributes, "%s.git/info/attributes", updir))
+				signature = stat_signature(signature, attributes);
+			break;
+		}
+	}
+
+	return signature;
+}
+
+/* Returns the value of the encoding attribute or NULL on failure. */
+static const char *
+check_attr_encoding(const char *path)
+{
+	int retries;
+
+	for (retries = 0; retries < 2; retries++) {
+		struct io *replies = &check_attr_batch.replies;
+		struct buffer name, attr, value;
+
+		if (!io_batch_start(&check_attr_batch))
+			return NULL;
+
+		/* Replies are "<path> NUL encoding NUL <value> NUL". */
+		if (io_write(&check_attr_batch.requests, path, strlen(path) + 1) &&
+		    io_get(replies, &name, 0, true) &&
+		    io_get(replies, &attr, 0, true) &&
+		    io_get(replies, &value, 0, true))
+			return value.data;
+
+		io_batch_stop(&check_attr_batch);
+	}
+
+	return NULL;
+}
+
+/* Detect the charset like file --mime does for text files from the start
+ * of the file. Returns NULL for binary or unreadable files. */
+static const char *
+detect_charset(const char *path)
+{
+	unsigned char data[BUFSIZ];
+	int fd = open(path, O_RDONLY);
+	ssize_t size;
+	size_t i;
+	int error;
+
+	if (fd == -1)
+		return NULL;
+	size = read(fd, data, sizeof(data));
+	close(fd);
+
+	if (size <= 0)
+		return NULL;
+	if (size >= 2 && data[0] == 0xfe && data[1] == 0xff)
+		return "UTF-16BE";
+	if (size >= 2 && data[0] == 0xff && data[1] == 0xfe)
+		return "UTF-16LE";
+	if (memchr(data, 0, size))
+		return NULL;
+
+	for (i = 0; i < size && data[i] < 0x80; i++)
+		;
+	if (i == size)
+		return "us-ascii";
+
+	return utf8_valid_prefix((char *) data, size, &error) == size || error == EINVAL
+	       ? "utf-8" : "iso-8859-1";
+}
+
+struct encoding *
+get_path_encoding(const char *path, struct encoding *default_encoding)
+{
+	struct path_encoding *entry;
+	unsigned long signature;
+	const char *encoding;
+	void **slot;
+
+	if (!*path)
+		return default_encoding;
+
+	signature = path_encoding_signature(path);
+	entry = string_map_get(&path_encodings, path);
+	if (entry && entry->signature == signature)
+		return entry->encoding ? entry->encoding : default_encoding;
+
+	encoding = check_attr_encoding(path);
+	if (!encoding)
+		return default_encoding;
+
+	/* Only detect the charset when no encoding has been configured. */
+	if (!strcmp(encoding, ENCODING_UTF8)
+	    || !strcmp(encoding, "unspecified")
+	    || !strcmp(encoding, "set"))
+		encoding = default_encoding ? NULL : detect_charset(path);
+
+	if (!entry) {
+		entry = calloc(1, sizeof(*entry) + strlen(path));
+		if (!entry)
+			return default_encoding;
+		strcpy(entry->path, path);
+		slot = string_map_put_to(&path_encodings, entry->path);
+		if (!slot) {
+			free(entry);
+			return default_encoding;
+		}
+		*slot = entry;
+	}
+
+	entry->encoding = encoding ? encoding_open(encoding) : NULL;
+	entry->signature = signature;
+	return entry->encoding ? entry->encoding : default_encoding;
+}
+
 bool
 io_from_string(struct io *io, const char *str)
 {
@@ -599,11 +1851,10 @@ io_from_string(struct io *io, const char *str)
 
 	io_init(io);
 
-	if (!io_realloc_buf(&io->buf, io->bufalloc, len))
+	if (!io_realloc_buf(io, len + 1))
 		return false;
 
-	io->bufsize = io->bufalloc = len;
-	io->bufpos = io->buf;
+	io->bufsize = len;
 	io->eof = true;
 	strncpy(io->buf, str, len);
 
@@ -30,7 +30,7 @@
  * Main view backend
  */
 
-DEFINE_ALLOCATOR(realloc_reflogs, char *, 32)
+DEFINE_GEOMETRIC_ALLOCATOR(realloc_reflogs, char *, 32)
 
 bool
 main_status_exists(struct view *view, enum line_type type)
@@ -86,7 +86,7 @@ main_add_commit(struct view *view, enum line_type type, struct commit *template,
 	titlelen = strlen(title);
 
 	line = add_line_alloc(view, &commit, type, titlelen, custom);
-	if (!line)
+	if (!line || !view_add_id(view, template->id, line - view->line))
 		return NULL;
 
 	*commit = *template;
@@ -397,10 +397,8 @@ main_read(struct view *view, struct buffer *buf, bool force_stop)
 			struct commit *last = view->line[view->lines - 1].data;
 
 			view->line[view->lines - 1].dirty = 1;
-			if (!last->author) {
+			if (!last->author)
 				view->lines--;
-				free(last);
-			}
 		}
 
 		if (state->graph)
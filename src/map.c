@@ -96,6 +96,14 @@ string_map_clear(struct string_map *map)
 		htab_empty(map->htab);
 }
 
+void
+string_map_free(struct string_map *map)
+{
+	if (map->htab)
+		htab_delete(map->htab);
+	map->htab = NULL;
+}
+
 struct string_map_iterator {
 	string_map_iterator_fn fn;
 	void *data;
@@ -12,6 +12,7 @@
  */
 
 #include "tig/io.h"
+#include "tig/map.h"
 #include "tig/options.h"
 #include "tig/parse.h"
 #include "tig/display.h"
@@ -29,8 +30,12 @@ struct reference {
 	struct time time;		/* Date of the last activity. */
 	char title[128];		/* First line of the commit message. */
 	const struct ref *ref;		/* Name and commit ID information. */
+	struct reference *next;		/* Next reference to the same commit. */
 };
 
+/* References by commit ID. */
+DEFINE_STRING_MAP(refs_by_id, struct reference *, ref->id, 32)
+
 static const struct ref *refs_all;
 #define REFS_ALL_NAME	"All references"
 #define refs_is_all(reference) ((reference)->ref == refs_all)
@@ -85,12 +90,18 @@ static bool
 refs_read(struct view *view, struct buffer *buf, bool force_stop)
 {
 	struct reference template = {0};
+	struct reference *reference;
 	char *author;
 	char *title;
 	size_t i;
 
-	if (!buf)
+	if (!buf) {
+		/* The lines may have been sorted while loading so update the
+		 * column widths once all references are annotated. */
+		for (i = 0; i < view->lines; i++)
+			view_column_info_update(view, &view->line[i]);
 		return true;
+	}
 
 	if (!*buf->data)
 		return false;
@@ -101,20 +112,14 @@ refs_read(struct view *view, struct buffer *buf, bool force_stop)
 	if (author)
 		parse_author_line(author, &template.author, &template.time);
 
-	for (i = 0; i < view->lines; i++) {
-		struct reference *reference = view->line[i].data;
-
-		if (strcmp(reference->ref->id, buf->data))
-			continue;
-
+	for (reference = string_map_get(&refs_by_id, buf->data); reference; reference = reference->next) {
 		reference->author = template.author;
 		reference->time = template.time;
 
 		if (title)
 			string_expand(reference->title, sizeof(reference->title), title, strlen(title), 1);
 
-		view->line[i].dirty = true;
-		view_column_info_update(view, &view->line[i]);
+		view->force_redraw = true;
 	}
 
 	return true;
@@ -135,17 +140,28 @@ refs_open_visitor(void *data, const struct ref *ref)
 	reference->ref = ref;
 	view_column_info_update(view, line);
 
+	if (!is_all) {
+		struct reference **slot = (struct reference **) string_map_put_to(&refs_by_id, ref->id);
+
+		if (!slot)
+			return false;
+		reference->next = *slot;
+		*slot = reference;
+	}
+
 	return true;
 }
 
 static enum status_code
 refs_open(struct view *view, enum open_flags flags)
 {
+	/* Only the commits at the tips of the references are needed, so
+	 * avoid walking the history. */
 	const char *refs_log[] = {
 		"git", "log", encoding_arg, "--no-color", "--date=raw",
 			opt_mailmap ? "--pretty=format:%H%x00%aN <%aE> %ad%x00%s"
 				    : "--pretty=format:%H%x00%an <%ae> %ad%x00%s",
-			"--all", "--simplify-by-decoration", NULL
+			"--all", "--no-walk", NULL
 	};
 	enum status_code code;
 
@@ -165,6 +181,7 @@ refs_open(struct view *view, enum open_flags flags)
 
 	if (!view->lines)
 		view->sort.current = get_view_column(view, VIEW_COLUMN_REF);
+	string_map_clear(&refs_by_id);
 	refs_open_visitor(view, refs_all);
 	foreach_ref(refs_open_visitor, view);
 	resort_view(view, true);
@@ -18,45 +18,78 @@
 #include "tig/main.h"
 #include "tig/graph.h"
 
-DEFINE_ALLOCATOR(realloc_unsigned_ints, unsigned int, 32)
+DEFINE_GEOMETRIC_ALLOCATOR(realloc_unsigned_ints, unsigned int, 32)
+
+/* Search threads use their own copy of the compiled search, since
+ * regexec() may serialize callers sharing the same regex_t. */
+static THREAD_LOCAL regex_t *search_regex;
+
+/* Match a search string without regexp operators. When case is ignored,
+ * candidates are found by looking for either case of the first character
+ * and the rest is compared with strncasecmp(). */
+static bool
+grep_literal(struct view *view, const char *text)
+{
+	const char *search = view->grep;
+	size_t searchlen;
+
+	if (!*view->grep_first)
+		return !!strstr(text, search);
+
+	searchlen = strlen(search + 1);
+	while ((text = strpbrk(text, view->grep_first))) {
+		if (!strncasecmp(text + 1, search + 1, searchlen))
+			return true;
+		text++;
+	}
+
+	return false;
+}
 
 bool
 grep_text(struct view *view, const char *text[])
 {
+	regex_t *regex = search_regex ? search_regex : view->regex;
 	size_t i;
 
-	for (i = 0; text[i]; i++)
-		if (*text[i] && !regexec(view->regex, text[i], 0, NULL, 0))
+	for (i = 0; text[i]; i++) {
+		if (!*text[i])
+			continue;
+		if (view->grep_literal ? grep_literal(view, text[i])
+				       : !regexec(regex, text[i], 0, NULL, 0))
 			return true;
+	}
 	return false;
 }
 
+/* Lines are searched from the main loop in slices of SEARCH_BATCH lines
+ * until SEARCH_SLICE_TIME (in microseconds) has passed, so the view stays
+ * responsive while a search runs through a large view. Scripts search one
+ * batch per slice so that their results do not depend on timing. */
+#define SEARCH_BATCH		1024
+#define SEARCH_SLICE_TIME	20000
+
 static bool
-find_matches(struct view *view)
+search_line(struct view *view, size_t lineno, unsigned int **matched_line, size_t *matched_lines)
 {
-	size_t lineno;
-
-	/* Note, lineno is unsigned long so will wrap around in which case it
-	 * will become bigger than view->lines. */
-	for (lineno = 0; lineno < view->lines; lineno++) {
-		if (!view->ops->grep(view, &view->line[lineno]))
-			continue;
-
-		if (!realloc_unsigned_ints(&view->matched_line, view->matched_lines, 1))
-			return false;
+	struct line *line = &view->line[lineno];
+	bool matched = view->ops->grep(view, line);
 
-		view->line[lineno].search_result = true;
-		view->matched_line[view->matched_lines++] = lineno;
+	if (line->search_result != matched) {
+		line->search_result = matched;
+		line->dirty = true;
 	}
 
-	/* Clear and show highlighted results. */
-	redraw_view_from(view, 0);
+	if (!matched)
+		return true;
 
+	if (!realloc_unsigned_ints(matched_line, *matched_lines, 1))
+		return false;
+
+	(*matched_line)[(*matched_lines)++] = lineno;
 	return true;
 }
 
-static enum status_code find_next_match(struct view *view, enum request request);
-
 static bool contains_uppercase(const char *search)
 {
 	const char *c = search;
@@ -67,17 +100,524 @@ static bool contains_uppercase(const char *search)
 	return false;
 }
 
-static enum status_code
-setup_and_find_next(struct view *view, enum request request)
+/*
+ * Search threads.
+ *
+ * With search-threads set, each batch of lines is split between a pool of
+ * threads, which the main loop waits for. The threads only call the view's
+ * grep, so only views using view_column_grep() are searched this way.
+ */
+
+#define SEARCH_THREADS_MAX	64
+
+struct search_thread {
+	pthread_t thread;
+	regex_t regex;
+	bool compiled;
+	size_t from, to;		/* Lines to search in the current round. */
+	unsigned int *matched_line;	/* Matches found in the current round. */
+	size_t matched_lines;
+	bool ok;
+};
+
+static struct search_thread search_threads[SEARCH_THREADS_MAX];
+static size_t search_threads_started;
+static struct view *search_threads_view;
+static char search_threads_grep[SIZEOF_STR];
+static int search_threads_flags;
+
+static pthread_mutex_t search_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t search_threads_round_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t search_threads_round_done = PTHREAD_COND_INITIALIZER;
+static unsigned long search_threads_round;
+static size_t search_threads_busy;
+
+static void *
+search_thread_run(void *data)
+{
+	struct search_thread *thread = data;
+	unsigned long round = 0;
+
+	search_regex = &thread->regex;
+
+	pthread_mutex_lock(&search_threads_lock);
+	while (true) {
+		size_t lineno;
+
+		while (round == search_threads_round)
+			pthread_cond_wait(&search_threads_round_start, &search_threads_lock);
+		round = search_threads_round;
+		pthread_mutex_unlock(&search_threads_lock);
+
+		thread->matched_lines = 0;
+		thread->ok = true;
+		for (lineno = thread->from; thread->ok && lineno < thread->to; lineno++)
+			thread->ok = search_line(search_threads_view, lineno,
+						 &thread->matched_line, &thread->matched_lines);
+
+		pthread_mutex_lock(&search_threads_lock);
+		if (--search_threads_busy == 0)
+			pthread_cond_signal(&search_threads_round_done);
+	}
+
+	return NULL;
+}
+
+static int
+search_regex_flags(const char *search)
 {
-	int regex_err;
 	int regex_flags = opt_ignore_case == IGNORE_CASE_YES ? REG_ICASE : 0;
 
 	if (opt_ignore_case == IGNORE_CASE_SMART_CASE
-	    && !contains_uppercase(view->env->search))
+	    && !contains_uppercase(search))
 		regex_flags |= REG_ICASE;
 
+	return REG_EXTENDED | regex_flags;
+}
+
+/* Returns the number of threads to search the view with, starting threads
+ * and compiling their copy of the search as needed. */
+static size_t
+search_threads_prepare(struct view *view)
+{
+	size_t threads = MIN(opt_search_threads, SEARCH_THREADS_MAX);
+	int flags = search_regex_flags(view->grep);
+	size_t i;
+
+	if (threads < 2 || view->ops->grep != view_column_grep)
+		return 1;
+
+	while (search_threads_started < threads) {
+		struct search_thread *thread = &search_threads[search_threads_started];
+
+		if (pthread_create(&thread->thread, NULL, search_thread_run, thread))
+			break;
+		search_threads_started++;
+	}
+
+	threads = MIN(threads, search_threads_started);
+	if (threads < 2)
+		return 1;
+
+	if (strcmp(search_threads_grep, view->grep) || search_threads_flags != flags) {
+		for (i = 0; i < search_threads_started; i++) {
+			struct search_thread *thread = &search_threads[i];
+
+			if (thread->compiled)
+				regfree(&thread->regex);
+			thread->compiled = false;
+		}
+		string_copy(search_threads_grep, view->grep);
+		search_threads_flags = flags;
+	}
+
+	for (i = 0; i < threads && !view->grep_literal; i++) {
+		struct search_thread *thread = &search_threads[i];
+
+		if (!thread->compiled &&
+		    regcomp(&thread->regex, search_threads_grep, search_threads_flags))
+			return 1;
+		thread->compiled = true;
+	}
+
+	return threads;
+}
+
+static bool
+search_lines_threaded(struct view *view, size_t from, size_t to, size_t threads)
+{
+	size_t lines = (to - from + threads - 1) / threads;
+	size_t i;
+
+	pthread_mutex_lock(&search_threads_lock);
+	search_threads_view = view;
+	for (i = 0; i < threads; i++) {
+		search_threads[i].from = MIN(from + i * lines, to);
+		search_threads[i].to = MIN(from + (i + 1) * lines, to);
+	}
+	search_threads_busy = threads;
+	search_threads_round++;
+	pthread_cond_broadcast(&search_threads_round_start);
+	while (search_threads_busy)
+		pthread_cond_wait(&search_threads_round_done, &search_threads_lock);
+	pthread_mutex_unlock(&search_threads_lock);
+
+	/* Merge the matches in line order. */
+	for (i = 0; i < threads; i++) {
+		struct search_thread *thread = &search_threads[i];
+
+		if (!thread->ok ||
+		    !realloc_unsigned_ints(&view->matched_line, view->matched_lines, thread->matched_lines))
+			return false;
+
+		memcpy(view->matched_line + view->matched_lines, thread->matched_line,
+		       thread->matched_lines * sizeof(*thread->matched_line));
+		view->matched_lines += thread->matched_lines;
+	}
+
+	return true;
+}
+
+/*
+ * Narrowing searches.
+ *
+ * Finished searches are kept in a small cache. A search that extends a
+ * cached plain string search only has to check the lines that matched the
+ * shorter string, and searching for a cached string again reuses its
+ * matches. This makes searching as you type faster as the search grows,
+ * and going back with backspace does not search the view again.
+ *
+ * Searches made while the view was loading are not cached, since lines
+ * may still be filled in. A view's cached searches are dropped when its
+ * lines change after loading, such as when columns are toggled or the
+ * view is sorted.
+ */
+
+#define SEARCH_CACHE_SIZE	8
+
+static struct search_cache {
+	struct view *view;
+	char grep[SIZEOF_STR];
+	int flags;
+	bool literal;
+	unsigned int *matched_line;
+	size_t matched_lines;
+	size_t lines;		/* Number of lines that were searched. */
+} search_cache[SEARCH_CACHE_SIZE];
+
+static void
+search_cache_remove(struct search_cache *cache, bool free_matches)
+{
+	size_t i = cache - search_cache;
+
+	if (free_matches)
+		free(cache->matched_line);
+	memmove(cache, cache + 1, (SEARCH_CACHE_SIZE - i - 1) * sizeof(*cache));
+	memset(&search_cache[SEARCH_CACHE_SIZE - 1], 0, sizeof(*cache));
+}
+
+/* Clear the current search results and move them to the cache if the
+ * search has finished. */
+static void
+search_cache_put(struct view *view)
+{
+	struct search_cache *cache;
+	size_t i;
+
+	for (i = 0; i < view->matched_lines; i++) {
+		struct line *line = &view->line[view->matched_line[i]];
+
+		line->search_result = false;
+		line->dirty = true;
+	}
+
+	if (!view->searching || search_has_lines(view) || view->search_candidate ||
+	    view->search_changed)
+		return;
+
+	for (i = 0; i < SEARCH_CACHE_SIZE; i++) {
+		cache = &search_cache[i];
+		if (cache->view == view && cache->flags == view->grep_flags &&
+		    !strcmp(cache->grep, view->grep)) {
+			search_cache_remove(cache, true);
+			break;
+		}
+	}
+
+	cache = &search_cache[SEARCH_CACHE_SIZE - 1];
+	if (cache->view)
+		free(cache->matched_line);
+	memmove(search_cache + 1, search_cache, (SEARCH_CACHE_SIZE - 1) * sizeof(*cache));
+
+	cache = &search_cache[0];
+	cache->view = view;
+	string_copy(cache->grep, view->grep);
+	cache->flags = view->grep_flags;
+	cache->literal = view->grep_literal;
+	cache->matched_line = view->matched_line;
+	cache->matched_lines = view->matched_lines;
+	cache->lines = view->search_next;
+
+	view->matched_line = NULL;
+	view->matched_lines = 0;
+}
+
+/* Drop the cached searches of a view whose lines have changed. The
+ * current search matched the old lines, so it is not cached either. */
+void
+search_cache_drop(struct view *view)
+{
+	size_t i;
+
+	if (view->searching)
+		view->search_changed = true;
+
+	for (i = 0; i < SEARCH_CACHE_SIZE; ) {
+		if (search_cache[i].view == view)
+			search_cache_remove(&search_cache[i], true);
+		else
+			i++;
+	}
+}
+
+/* Sort the matches of a cached search by marking them in a table of the
+ * searched lines, which is faster than comparison sorting when most lines
+ * match. */
+static bool
+sort_candidates(struct view *view, struct search_cache *cache)
+{
+	bool *matched = calloc(cache->lines, sizeof(*matched));
+	size_t i, candidates = 0;
+
+	view->search_candidate = malloc(cache->matched_lines * sizeof(*cache->matched_line));
+	if (!matched || !view->search_candidate) {
+		free(matched);
+		free(view->search_candidate);
+		view->search_candidate = NULL;
+		return false;
+	}
+
+	for (i = 0; i < cache->matched_lines; i++)
+		matched[cache->matched_line[i]] = true;
+
+	for (i = 0; i < cache->lines; i++)
+		if (matched[i])
+			view->search_candidate[candidates++] = i;
+
+	free(matched);
+	return true;
+}
+
+static void
+update_candidate_range(struct view *view)
+{
+	view->search_next = view->search_candidate_next < view->search_candidates
+			  ? view->search_candidate[view->search_candidate_next]
+			  : view->search_candidate_lines;
+	view->search_prev = view->search_candidate_prev > 0
+			  ? view->search_candidate[view->search_candidate_prev - 1] + 1
+			  : 0;
+}
+
+/* Start the search from a cached search for the same string, or narrow
+ * the longest cached string that the search extends. */
+static bool
+search_cache_get(struct view *view)
+{
+	bool icase = !!(view->grep_flags & REG_ICASE);
+	struct search_cache *found = NULL;
+	size_t i, first;
+
+	for (i = 0; i < SEARCH_CACHE_SIZE && search_cache[i].view; i++) {
+		struct search_cache *cache = &search_cache[i];
+		size_t cachelen = strlen(cache->grep);
+
+		if (cache->view != view || cache->flags != view->grep_flags ||
+		    cache->lines > view->lines)
+			continue;
+
+		if (!strcmp(cache->grep, view->grep)) {
+			found = cache;
+			break;
+		}
+
+		if (!view->grep_literal || !cache->literal ||
+		    (found && strlen(found->grep) >= cachelen) ||
+		    (icase ? strncasecmp(cache->grep, view->grep, cachelen)
+			   : strncmp(cache->grep, view->grep, cachelen)))
+			continue;
+
+		found = cache;
+	}
+
+	if (!found)
+		return false;
+
+	if (!strcmp(found->grep, view->grep)) {
+		view->matched_line = found->matched_line;
+		view->matched_lines = found->matched_lines;
+		view->search_prev = 0;
+		view->search_next = found->lines;
+		search_cache_remove(found, false);
+
+		for (i = 0; i < view->matched_lines; i++) {
+			struct line *line = &view->line[view->matched_line[i]];
+
+			line->search_result = true;
+			line->dirty = true;
+		}
+		return true;
+	}
+
+	if (found->matched_lines && !sort_candidates(view, found))
+		return false;
+
+	for (first = 0; first < found->matched_lines; first++)
+		if (view->search_candidate[first] >= view->pos.lineno)
+			break;
+
+	view->search_candidates = found->matched_lines;
+	view->search_candidate_prev = view->search_candidate_next = first;
+	view->search_candidate_lines = found->lines;
+	update_candidate_range(view);
+
+	if (!view->search_candidate) {
+		view->search_prev = 0;
+		view->search_next = found->lines;
+	}
+
+	return true;
+}
+
+/* Search the candidate lines in the same order as the lines are searched
+ * otherwise. Lines between the candidates cannot match, so they count as
+ * searched. */
+static bool
+find_candidate_matches(struct view *view)
+{
+	size_t batch;
+
+	for (batch = 0; batch < SEARCH_BATCH; batch++) {
+		size_t lineno;
+
+		if (view->search_candidate_next < view->search_candidates) {
+			lineno = view->search_candidate[view->search_candidate_next++];
+		} else if (view->search_candidate_prev > 0) {
+			lineno = view->search_candidate[--view->search_candidate_prev];
+		} else {
+			free(view->search_candidate);
+			view->search_candidate = NULL;
+			view->search_candidates = 0;
+			return true;
+		}
+
+		if (!search_line(view, lineno, &view->matched_line, &view->matched_lines))
+			return false;
+		update_candidate_range(view);
+	}
+
+	return true;
+}
+
+/* The search starts at the selected line and first searches towards the
+ * end of the view, including lines appended while the view is loading,
+ * before searching backwards from the selected line. The searched lines
+ * are always the range from search_prev up to search_next. */
+static bool
+find_matches(struct view *view)
+{
+	size_t threads = search_threads_prepare(view);
+	size_t batch = SEARCH_BATCH * threads;
+	double start = io_trace_clock();
+
+	if (view->pipe || view->lookup_pipe)
+		view->search_changed = true;
+
+	do {
+		size_t from, to, lineno;
+
+		if (view->search_candidate) {
+			if (!find_candidate_matches(view))
+				return false;
+			continue;
+		}
+
+		if (view->search_next < view->lines) {
+			from = view->search_next;
+			to = view->search_next = MIN(from + batch, view->lines);
+		} else if (view->search_prev > 0) {
+			to = view->search_prev;
+			from = view->search_prev = to > batch ? to - batch : 0;
+		} else {
+			return true;
+		}
+
+		if (threads > 1) {
+			if (!search_lines_threaded(view, from, to, threads))
+				return false;
+			continue;
+		}
+
+		for (lineno = from; lineno < to; lineno++)
+			if (!search_line(view, lineno, &view->matched_line, &view->matched_lines))
+				return false;
+	} while (!is_script_executing() && io_trace_clock() - start < SEARCH_SLICE_TIME);
+
+	return true;
+}
+
+bool
+search_has_lines(struct view *view)
+{
+	return view->searching &&
+	       (view->search_next < view->lines || view->search_prev > 0);
+}
+
+static bool
+search_is_running(struct view *view)
+{
+	return search_has_lines(view) || (view->searching && view->pipe);
+}
+
+static void
+start_search(struct view *view)
+{
+	if (view->search_prev == view->search_next && !search_cache_get(view))
+		view->search_prev = view->search_next = view->pos.lineno;
+	view->searching = true;
+}
+
+static void
+clear_search(struct view *view)
+{
+	free(view->matched_line);
+	view->matched_line = NULL;
+	view->matched_lines = 0;
+	view->searching = false;
+	view->search_direction = 0;
+	view->search_prev = view->search_next = 0;
+	free(view->search_candidate);
+	view->search_candidate = NULL;
+	view->search_candidates = 0;
+	view->search_changed = false;
+}
+
+static enum status_code find_next_match(struct view *view, enum request request);
+
+/* Searches without regexp operators are matched as plain strings. The
+ * regexp is still compiled to highlight the matches. Case-insensitive
+ * searches only use plain matching for ASCII strings, since folding other
+ * characters depends on the locale. */
+static void
+setup_literal_search(struct view *view, bool icase)
+{
+	const char *c;
+
+	view->grep_literal = !strpbrk(view->grep, "\\^$.[]|()*+?{}");
+	memset(view->grep_first, 0, sizeof(view->grep_first));
+
+	if (!view->grep_literal || !icase)
+		return;
+
+	for (c = view->grep; *c; c++) {
+		if (!isascii(*c)) {
+			view->grep_literal = false;
+			return;
+		}
+	}
+
+	view->grep_first[0] = tolower(*view->grep);
+	if (toupper(*view->grep) != view->grep_first[0])
+		view->grep_first[1] = toupper(*view->grep);
+}
+
+static enum status_code
+setup_and_find_next(struct view *view, enum request request)
+{
+	int regex_err;
+
 	if (view->regex) {
+		search_cache_put(view);
 		regfree(view->regex);
 		*view->grep = 0;
 	} else {
@@ -86,7 +626,7 @@ setup_and_find_next(struct view *view, enum request request)
 			return ERROR_OUT_OF_MEMORY;
 	}
 
-	regex_err = regcomp(view->regex, view->env->search, REG_EXTENDED | regex_flags);
+	regex_err = regcomp(view->regex, view->env->search, search_regex_flags(view->env->search));
 	if (regex_err != 0) {
 		char buf[SIZEOF_STR] = "unknown error";
 
@@ -95,45 +635,94 @@ setup_and_find_next(struct view *view, enum request request)
 	}
 
 	string_copy(view->grep, view->env->search);
+	view->grep_flags = search_regex_flags(view->grep);
+	setup_literal_search(view, view->grep_flags & REG_ICASE);
 
-	reset_search(view);
+	clear_search(view);
 
 	return find_next_match(view, request);
 }
 
-static enum status_code
-find_next_match_line(struct view *view, int direction, bool wrapped)
+/* Find the closest match in the search direction, or with wrapped set, the
+ * match furthest away on the other side of the selected line. The matches
+ * are not sorted, since lines are searched in both directions. */
+static size_t
+find_next_match_index(struct view *view, int direction, bool wrapped)
 {
-	/* Note, `i` is unsigned and will wrap around in which case it
-	 * will become bigger than view->matched_lines. */
-	size_t i = direction > 0 ? 0 : view->matched_lines - 1;
+	size_t found = view->matched_lines;
+	size_t i;
 
-	for (; i < view->matched_lines; i += direction) {
+	for (i = 0; i < view->matched_lines; i++) {
 		size_t lineno = view->matched_line[i];
+		bool after = direction > 0 ? lineno > view->pos.lineno
+					   : lineno < view->pos.lineno;
 
-		if (direction > 0) {
-			if (!wrapped && lineno <= view->pos.lineno)
-				continue;
-			if (wrapped && lineno > view->pos.lineno)
-				continue;
-		} else {
-			if (!wrapped && lineno >= view->pos.lineno)
-				continue;
-			if (wrapped && lineno < view->pos.lineno)
-				continue;
-		}
+		if (after == wrapped)
+			continue;
 
-		select_view_line(view, lineno);
-		return success("Line %zu matches '%s' (%zu of %zu)", lineno + 1, view->grep, i + 1, view->matched_lines);
+		if (found == view->matched_lines ||
+		    (direction > 0 ? lineno < view->matched_line[found]
+				   : lineno > view->matched_line[found]))
+			found = i;
 	}
 
-	return -1;
+	return found;
+}
+
+static enum status_code
+report_match(struct view *view, size_t lineno)
+{
+	size_t i, nth = 0;
+
+	for (i = 0; i < view->matched_lines; i++)
+		if (view->matched_line[i] <= lineno)
+			nth++;
+
+	return success("Line %zu matches '%s' (%zu of %zu)", lineno + 1, view->grep, nth, view->matched_lines);
+}
+
+static enum status_code
+select_match(struct view *view, size_t index)
+{
+	size_t lineno = view->matched_line[index];
+
+	view->search_direction = 0;
+	select_view_line(view, lineno);
+	return report_match(view, lineno);
+}
+
+/* A match is only selected once all lines between it and the selected line
+ * have been searched. Until then, the search direction is remembered and
+ * update_search() selects the match when it is found. */
+static enum status_code
+find_next_match_line(struct view *view, int direction)
+{
+	size_t lineno = view->pos.lineno;
+	size_t index = find_next_match_index(view, direction, false);
+
+	if (index < view->matched_lines &&
+	    (direction > 0 ? view->search_prev <= lineno + 1
+			   : view->search_next >= lineno))
+		return select_match(view, index);
+
+	if (search_is_running(view)) {
+		view->search_direction = direction;
+		return success("Searching for '%s': %zu matches", view->grep, view->matched_lines);
+	}
+
+	if (opt_wrap_search) {
+		index = find_next_match_index(view, direction, true);
+		if (index < view->matched_lines)
+			return select_match(view, index);
+	}
+
+	view->search_direction = 0;
+	return success("No match found for '%s'", view->grep);
 }
 
 static enum status_code
 find_next_match(struct view *view, enum request request)
 {
-	enum status_code code;
 	int direction;
 
 	if (!*view->grep || strcmp(view->grep, view->env->search)) {
@@ -157,14 +746,15 @@ find_next_match(struct view *view, enum request request)
 		return error("Unknown search request");
 	}
 
-	if (!view->matched_lines && !find_matches(view))
-		return ERROR_OUT_OF_MEMORY;
-
-	code = find_next_match_line(view, direction, false);
-	if (code != SUCCESS && opt_wrap_search)
-		code = find_next_match_line(view, direction, true);
+	if (!view->searching) {
+		start_search(view);
+		if (!find_matches(view))
+			return ERROR_OUT_OF_MEMORY;
+		if (view_is_displayed(view))
+			redraw_view_dirty(view);
+	}
 
-	return code == SUCCESS ? code : success("No match found for '%s'", view->grep);
+	return find_next_match_line(view, direction);
 }
 
 void
@@ -235,19 +825,158 @@ find_merge(struct view *view, enum request request)
 	report("%s", get_status_message(code));
 }
 
+void
+update_search(struct view *view)
+{
+	bool waiting = !!view->search_direction;
+	enum status_code code;
+
+	if (!find_matches(view)) {
+		report("Allocation failure");
+		stop_search(view);
+		return;
+	}
+
+	if (view_is_displayed(view))
+		redraw_view_dirty(view);
+
+	if (waiting)
+		code = find_next_match_line(view, view->search_direction);
+
+	if (view != display[current_view])
+		return;
+
+	if (view->search_direction && view->lines)
+		report("Searching for '%s': %zu matches (%zu%%)", view->grep, view->matched_lines,
+		       (view->search_next - view->search_prev) * 100 / view->lines);
+	else if (waiting)
+		report("%s", get_status_message(code));
+	else if (!search_has_lines(view) && view->pos.lineno < view->lines &&
+		 view->line[view->pos.lineno].search_result)
+		report("%s", get_status_message(report_match(view, view->pos.lineno)));
+	else if (!search_has_lines(view))
+		report("Found %zu matches for '%s'", view->matched_lines, view->grep);
+}
+
+bool
+stop_search(struct view *view)
+{
+	if (!search_has_lines(view) && !view->search_direction)
+		return false;
+
+	view->searching = false;
+	view->search_direction = 0;
+	report("Stopped searching for '%s': %zu matches", view->grep, view->matched_lines);
+	return true;
+}
+
 void
 reset_search(struct view *view)
 {
-	free(view->matched_line);
-	view->matched_line = NULL;
-	view->matched_lines = 0;
+	clear_search(view);
+	search_cache_drop(view);
+}
+
+struct search_input {
+	struct view *view;
+	enum request request;
+	unsigned long lineno;	/* Line selected before the search. */
+	char previous[SIZEOF_STR];
+	enum status_code code;
+};
+
+static void
+search_as_you_type(struct search_input *input, const char *search, size_t searchlen)
+{
+	struct view *view = input->view;
+
+	select_view_line(view, input->lineno);
+	string_ncopy(argv_env.search, search, searchlen);
+	if (searchlen) {
+		input->code = setup_and_find_next(view, input->request);
+	} else {
+		search_cache_put(view);
+		clear_search(view);
+		input->code = SUCCESS;
+	}
+	if (view_is_displayed(view))
+		redraw_view_dirty(view);
+}
+
+/* Forget the searches made while typing and restore the previous search
+ * string, which is compiled again by the next find request. */
+static void
+cancel_search(struct search_input *input)
+{
+	struct view *view = input->view;
+
+	if (strcmp(view->grep, input->previous)) {
+		search_cache_put(view);
+		clear_search(view);
+		if (view->regex) {
+			regfree(view->regex);
+			free(view->regex);
+			view->regex = NULL;
+		}
+		*view->grep = 0;
+	}
+
+	view->search_direction = 0;
+	string_copy(argv_env.search, input->previous);
+	select_view_line(view, input->lineno);
+	if (view_is_displayed(view))
+		redraw_view_dirty(view);
+}
+
+static enum input_status
+search_input_handler(struct input *input, struct key *key)
+{
+	struct search_input *search = input->data;
+	enum input_status status = prompt_default_handler(input, key);
+
+	if (status == INPUT_DELETE) {
+		/* The last character is removed after returning. */
+		size_t searchlen = strlen(input->buf);
+
+		while (searchlen > 0 && (input->buf[--searchlen] & 0xC0) == 0x80)
+			;
+		search_as_you_type(search, input->buf, searchlen);
+		return status;
+	}
+
+	if (status == INPUT_CANCEL) {
+		cancel_search(search);
+		return status;
+	}
+
+	if (status != INPUT_SKIP)
+		return status;
+
+	if (key_to_value(key) == 0) {
+		search_as_you_type(search, input->buf, strlen(input->buf));
+		return INPUT_OK;
+	}
+
+	/* Catch all non-multibyte keys. */
+	return INPUT_SKIP;
 }
 
 void
 search_view(struct view *view, enum request request)
 {
 	const char *prompt = request == REQ_SEARCH ? "/" : "?";
-	char *search = read_prompt(prompt);
+	char *search;
+
+	if (opt_search_as_you_type) {
+		struct search_input input = { view, request, view->pos.lineno };
+
+		string_copy(input.previous, argv_env.search);
+		if (read_prompt_incremental(prompt, false, false, search_input_handler, &input))
+			report("%s", get_status_message(input.code));
+		return;
+	}
+
+	search = read_prompt(prompt);
 
 	if (search && *search) {
 		enum status_code code;
@@ -0,0 +1,146 @@
+/* Copyright (c) 2006-2015 Jonas Fonseca <jonas.fonseca@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "tig/view.h"
+#include "tig/search.h"
+#include "tig/draw.h"
+#include "tig/stats.h"
+
+/*
+ * Stats backend
+ */
+
+struct stats {
+	struct view *view;
+};
+
+static const char *stats_titles[] = {
+	"View", "Lines", "Bytes", "Allocs", "Load", "Lines/s",
+	"Commands", "Redraws", "Read", "Parse", "Draw",
+};
+
+static const int stats_widths[] = { 8, 9, 11, 9, 9, 10, 9, 8, 9, 9, 9 };
+
+static const char *
+stats_time(char *buf, size_t bufsize, double usecs)
+{
+	if (usecs >= 1e6)
+		snprintf(buf, bufsize, "%.2fs", usecs / 1e6);
+	else
+		snprintf(buf, bufsize, "%.1fms", usecs / 1e3);
+	return buf;
+}
+
+static bool
+stats_draw(struct view *view, struct line *line, unsigned int lineno)
+{
+	struct stats *stats = line->data;
+	char text[ARRAY_SIZE(stats_titles)][32] = {{0}};
+	int i;
+
+	if (!stats->view) {
+		for (i = 0; i < ARRAY_SIZE(stats_titles); i++)
+			string_ncopy(text[i], stats_titles[i], strlen(stats_titles[i]));
+
+	} else {
+		struct view *target = stats->view;
+		const struct view_stats *counters = &target->stats;
+		bool loaded = counters->loads > 0;
+		double load_time = !loaded ? 0
+				 : target->pipe ? io_trace_clock() - counters->load_start
+				 : counters->load_time;
+
+		string_ncopy(text[0], target->name, strlen(target->name));
+		snprintf(text[1], sizeof(text[1]), "%zu", target->lines);
+		snprintf(text[2], sizeof(text[2]), "%zu", counters->bytes);
+		snprintf(text[3], sizeof(text[3]), "%zu", counters->allocs);
+		if (loaded) {
+			stats_time(text[4], sizeof(text[4]), load_time);
+			if (load_time > 0)
+				snprintf(text[5], sizeof(text[5]), "%.0f", target->lines * 1e6 / load_time);
+			stats_time(text[8], sizeof(text[8]), counters->read_time);
+			stats_time(text[9], sizeof(text[9]), counters->parse_time);
+		}
+		snprintf(text[6], sizeof(text[6]), "%u", counters->commands);
+		snprintf(text[7], sizeof(text[7]), "%u", counters->redraws);
+		stats_time(text[10], sizeof(text[10]), counters->draw_time);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(text); i++)
+		if (draw_field(view, line->type, *text[i] ? text[i] : "-", stats_widths[i],
+			       i ? ALIGN_RIGHT : ALIGN_LEFT, false))
+			return true;
+
+	return true;
+}
+
+static bool
+stats_grep(struct view *view, struct line *line)
+{
+	struct stats *stats = line->data;
+	const char *text[] = { stats->view ? stats->view->name : "", NULL };
+
+	return grep_text(view, text);
+}
+
+static enum status_code
+stats_open(struct view *view, enum open_flags flags)
+{
+	struct view *target;
+	struct stats *stats;
+	int i;
+
+	reset_view(view);
+
+	if (!add_line_alloc(view, &stats, LINE_HEADER, 0, true))
+		return ERROR_OUT_OF_MEMORY;
+
+	foreach_view(target, i) {
+		if (!add_line_alloc(view, &stats, LINE_DEFAULT, 0, false))
+			return ERROR_OUT_OF_MEMORY;
+		stats->view = target;
+	}
+
+	return SUCCESS;
+}
+
+static enum request
+stats_request(struct view *view, enum request request, struct line *line)
+{
+	switch (request) {
+	case REQ_REFRESH:
+		refresh_view(view);
+		return REQ_NONE;
+
+	default:
+		return request;
+	}
+}
+
+static struct view_ops stats_ops = {
+	"view",
+	"",
+	VIEW_NO_GIT_DIR | VIEW_REFRESH,
+	0,
+	stats_open,
+	NULL,
+	stats_draw,
+	stats_request,
+	stats_grep,
+	NULL,
+	NULL,
+};
+
+DEFINE_VIEW(stats);
+
+/* vim: set ts=8 sw=8 noexpandtab: */
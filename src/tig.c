@@ -40,6 +40,7 @@
 #include "tig/diff.h"
 #include "tig/grep.h"
 #include "tig/help.h"
+#include "tig/stats.h"
 #include "tig/log.h"
 #include "tig/main.h"
 #include "tig/pager.h"
@@ -207,6 +208,9 @@ view_driver(struct view *view, enum request request)
 	case REQ_VIEW_HELP:
 		open_help_view(view, OPEN_DEFAULT);
 		break;
+	case REQ_VIEW_STATS:
+		open_stats_view(view, OPEN_DEFAULT);
+		break;
 	case REQ_VIEW_REFS:
 		open_refs_view(view, OPEN_DEFAULT);
 		break;
@@ -294,6 +298,10 @@ view_driver(struct view *view, enum request request)
 		find_next(view, request);
 		break;
 
+	case REQ_STOP_SEARCH:
+		stop_search(view);
+		break;
+
 	case REQ_MOVE_NEXT_MERGE:
 	case REQ_MOVE_PREV_MERGE:
 		report("Moving between merge commits is not supported by the %s view", view->name);
@@ -688,6 +696,13 @@ key_combo_handler(struct input *input, struct key *key)
 	if (combo->keys && key_to_value(key) == KEY_ESC)
 		return INPUT_CANCEL;
 
+	/* Esc stops a search still running in the current view. */
+	if (!combo->keys && key_to_value(key) == KEY_ESC &&
+	    (search_has_lines(display[current_view]) || display[current_view]->search_direction)) {
+		combo->request = REQ_STOP_SEARCH;
+		return INPUT_STOP;
+	}
+
 	string_format_from(input->buf, &combo->bufpos, "%s%s",
 			   combo->bufpos ? " " : "Keys: ", get_key_name(key, 1, false));
 	combo->key[combo->keys++] = *key;
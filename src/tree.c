@@ -14,11 +14,13 @@
 #include "tig/util.h"
 #include "tig/repo.h"
 #include "tig/io.h"
+#include "tig/map.h"
 #include "tig/parse.h"
 #include "tig/options.h"
 #include "tig/display.h"
 #include "tig/view.h"
 #include "tig/draw.h"
+#include "tig/search.h"
 #include "tig/blob.h"
 
 /* The top of the path stack. */
@@ -53,7 +55,12 @@ push_tree_stack_entry(struct view *view, const char *name, struct position *posi
 
 /* Parse output from git-ls-tree(1):
  *
- * 100644 blob 95925677ca47beb0b8cce7c0e0011bcc3f61470f  213045	tig.c
+ * 100644 blob 95925677ca47beb0b8cce7c0e0011bcc3f61470f	tig.c
+ *
+ * File sizes are not requested from git-ls-tree since that requires
+ * looking up every blob before the first entry can be shown. Instead
+ * they are requested for the entries around the view port when drawn
+ * and filled in as the replies arrive.
  */
 
 #define SIZEOF_TREE_ATTR \
@@ -74,6 +81,9 @@ struct tree_entry {
 	struct time time;		/* Date from the author ident. */
 	const struct ident *author;	/* Author of the commit. */
 	unsigned long size;
+	bool size_checked;		/* Has the size been looked up? */
+	bool has_size;			/* Is the size known? */
+	size_t index;			/* Line index, updated when the lines move. */
 	char name[1];
 };
 
@@ -82,8 +92,21 @@ struct tree_state {
 	const struct ident *author;
 	struct time author_time;
 	bool read_date;
+	struct position prev_pos;	/* Position to restore once sorted. */
+	struct string_map entries;	/* Entries by name for annotating them. */
+	size_t annotated;		/* Number of entries with a date. */
+	struct tree_size *sizes;	/* Entries waiting for their size. */
+	size_t sizes_count;
+	size_t sizes_read;		/* Number of sizes read so far. */
+};
+
+struct tree_size {
+	struct tree_entry *entry;
+	size_t lineno;			/* Line index when requested. */
 };
 
+DEFINE_ALLOCATOR(tree_realloc_sizes, struct tree_size, 256)
+
 static const char *
 tree_path(const struct line *line)
 {
@@ -98,6 +121,93 @@ tree_compare_entry(const struct line *line1, const struct line *line2)
 	return strcmp(tree_path(line1), tree_path(line2));
 }
 
+static int
+tree_compare_line(const void *line1, const void *line2)
+{
+	return tree_compare_entry(line1, line2);
+}
+
+static const char *
+tree_entries_key(const void *entry)
+{
+	return ((const struct tree_entry *) entry)->name;
+}
+
+static string_map_key_t
+tree_entries_hash(const void *entry)
+{
+	return string_map_hash_helper(tree_entries_key(entry));
+}
+
+static const struct string_map tree_entries = { tree_entries_hash, tree_entries_key, 32 };
+
+/* Index of the first tree entry after the "Directory ..." and ".." lines. */
+static size_t
+tree_first_entry(struct view *view)
+{
+	return 1 + !!*view->env->directory;
+}
+
+/* Sort the entries once all of them have been read and index them by
+ * name for annotating them with the date of their last change. The
+ * entries are indexed rather than their lines, since the lines move
+ * when the view is sorted by another column. */
+static bool
+tree_sort_entries(struct view *view, struct tree_state *state)
+{
+	size_t first = tree_first_entry(view);
+	size_t i;
+
+	string_map_free(&state->entries);
+	state->entries = tree_entries;
+	if (view->lines <= first)
+		return true;
+
+	qsort(&view->line[first], view->lines - first, sizeof(*view->line), tree_compare_line);
+
+	for (i = first; i < view->lines; i++) {
+		struct line *line = &view->line[i];
+		struct tree_entry *entry = line->data;
+
+		line->lineno = i - first + 1;
+		line->dirty = line->cleareol = 1;
+		entry->index = i;
+		if (!string_map_put(&state->entries, entry->name, entry))
+			return false;
+	}
+
+	return true;
+}
+
+/* Find the line of an entry. All indexes are updated at once when the
+ * lines have been sorted since the entry was last looked up. */
+static struct line *
+tree_entry_line(struct view *view, struct tree_entry *entry)
+{
+	size_t i;
+
+	if (entry->index >= view->lines || view->line[entry->index].data != entry)
+		for (i = 0; i < view->lines; i++)
+			((struct tree_entry *) view->line[i].data)->index = i;
+
+	return &view->line[entry->index];
+}
+
+/* Mark the entry as annotated with the date and author of a commit. */
+static void
+tree_annotate_entry(struct view *view, struct tree_state *state, struct tree_entry *entry,
+		    const char *commit, const struct ident *author, const struct time *time)
+{
+	struct line *line = tree_entry_line(view, entry);
+
+	string_copy_rev(entry->commit, commit);
+	entry->author = author;
+	entry->time = *time;
+	line->dirty = 1;
+	view_column_info_update(view, line);
+	state->annotated++;
+}
+
 static bool
 tree_get_column_data(struct view *view, const struct line *line, struct view_column_data *column_data)
 {
@@ -108,7 +218,7 @@ tree_get_column_data(struct view *view, const struct line *line, struct view_col
 
 	column_data->author = entry->author;
 	column_data->date = &entry->time;
-	if (line->type != LINE_DIRECTORY)
+	if (line->type != LINE_DIRECTORY && entry->has_size)
 		column_data->file_size = &entry->size;
 	column_data->id = entry->commit;
 	column_data->mode = &entry->mode;
@@ -120,25 +230,116 @@ tree_get_column_data(struct view *view, const struct line *line, struct view_col
 
 static struct line *
 tree_entry(struct view *view, enum line_type type, const char *path,
-	   const char *mode, const char *id, unsigned long size)
+	   const char *mode, const char *id)
 {
 	bool custom = type == LINE_HEADER || tree_path_is_parent(path);
 	struct tree_entry *entry;
-	struct line *line = add_line_alloc(view, &entry, type, strlen(path), custom);
+	size_t pathlen = strlen(path);
+	struct line *line = add_line_alloc(view, &entry, type, pathlen, custom);
 
 	if (!line)
 		return NULL;
 
-	strncpy(entry->name, path, strlen(path));
+	string_ncopy_do(entry->name, pathlen + 1, path, pathlen);
 	if (mode)
 		entry->mode = strtoul(mode, NULL, 8);
 	if (id)
 		string_copy_rev(entry->id, id);
-	entry->size = size;
 
 	return line;
 }
 
+/*
+ * The date and author of the last change of each entry are cached by
+ * commit and directory for the session so going back to a directory
+ * does not have to walk the history again.
+ */
+
+struct tree_date {
+	const char *name;
+	char commit[SIZEOF_REV];
+	const struct ident *author;
+	struct time time;
+};
+
+struct tree_dates {
+	size_t size;
+	struct tree_date *dates;
+	char key[1];
+};
+
+DEFINE_STRING_MAP(tree_dates_cache, struct tree_dates *, key, 32)
+
+static bool
+tree_dates_key(struct view *view, char key[SIZEOF_STR])
+{
+	return iscommit(view->vid) &&
+	       string_nformat(key, SIZEOF_STR, NULL, "%s:%s", view->vid, view->env->directory);
+}
+
+static bool
+tree_load_dates(struct view *view, struct tree_state *state)
+{
+	struct tree_dates *dates;
+	char key[SIZEOF_STR];
+	size_t i;
+
+	if (!tree_dates_key(view, key) || !(dates = string_map_get(&tree_dates_cache, key)))
+		return false;
+
+	for (i = 0; i < dates->size; i++) {
+		struct tree_date *date = &dates->dates[i];
+		struct tree_entry *entry = string_map_get(&state->entries, date->name);
+
+		if (entry && !entry->author)
+			tree_annotate_entry(view, state, entry, date->commit, date->author, &date->time);
+	}
+
+	return true;
+}
+
+static void
+tree_save_dates(struct view *view, struct tree_state *state)
+{
+	struct tree_dates *dates;
+	char key[SIZEOF_STR];
+	size_t i;
+
+	if (!tree_dates_key(view, key) || string_map_get(&tree_dates_cache, key))
+		return;
+
+	dates = calloc(1, sizeof(*dates) + strlen(key));
+	if (!dates)
+		return;
+	strcpy(dates->key, key);
+	dates->dates = calloc(state->annotated, sizeof(*dates->dates));
+	if (state->annotated && !dates->dates) {
+		free(dates);
+		return;
+	}
+
+	for (i = tree_first_entry(view); i < view->lines && dates->size < state->annotated; i++) {
+		struct tree_entry *entry = view->line[i].data;
+		struct tree_date *date = &dates->dates[dates->size];
+
+		if (!entry->author)
+			continue;
+
+		date->name = get_path(entry->name);
+		if (!date->name)
+			break;
+		string_copy_rev(date->commit, entry->commit);
+		date->author = entry->author;
+		date->time = entry->time;
+		dates->size++;
+	}
+
+	if (!string_map_put(&tree_dates_cache, dates->key, dates)) {
+		free(dates->dates);
+		free(dates);
+	}
+}
+
 static bool
 tree_read_date(struct view *view, struct buffer *buf, struct tree_state *state)
 {
@@ -156,12 +357,15 @@ tree_read_date(struct view *view, struct buffer *buf, struct tree_state *state)
 		};
 
 		if (!view->lines) {
-			tree_entry(view, LINE_HEADER, view->env->directory, NULL, NULL, 0);
-			tree_entry(view, LINE_DIRECTORY, "..", "040000", view->ref, 0);
+			tree_entry(view, LINE_HEADER, view->env->directory, NULL, NULL);
+			tree_entry(view, LINE_DIRECTORY, "..", "040000", view->ref);
 			report("Tree is empty");
 			return true;
 		}
 
+		if (tree_load_dates(view, state))
+			return true;
+
 		if (begin_update(view, repo.cdup, log_file, OPEN_EXTRA) != SUCCESS) {
 			report("Failed to load tree data");
 			return true;
@@ -178,9 +382,8 @@ tree_read_date(struct view *view, struct buffer *buf, struct tree_state *state)
 				  &state->author, &state->author_time);
 
 	} else if (*text == ':') {
+		struct tree_entry *entry;
 		char *pos;
-		size_t annotated = 1;
-		size_t i;
 
 		pos = strrchr(text, '\t');
 		if (!pos)
@@ -192,23 +395,14 @@ tree_read_date(struct view *view, struct buffer *buf, struct tree_state *state)
 		if (pos)
 			*pos = 0;
 
-		for (i = 1; i < view->lines; i++) {
-			struct line *line = &view->line[i];
-			struct tree_entry *entry = line->data;
-
-			annotated += !!entry->author;
-			if (entry->author || strcmp(entry->name, text))
-				continue;
+		entry = string_map_get(&state->entries, text);
+		if (!entry || entry->author)
+			return true;
 
-			string_copy_rev(entry->commit, state->commit);
-			entry->author = state->author;
-			entry->time = state->author_time;
-			line->dirty = 1;
-			view_column_info_update(view, line);
-			break;
-		}
+		tree_annotate_entry(view, state, entry, state->commit, state->author, &state->author_time);
 
-		if (annotated == view->lines)
+		/* Stop walking the history once every entry has a date. */
+		if (state->annotated == view->lines - tree_first_entry(view))
 			io_kill(view->pipe);
 	}
 	return true;
@@ -218,26 +412,40 @@ static bool
 tree_read(struct view *view, struct buffer *buf, bool force_stop)
 {
 	struct tree_state *state = view->private;
-	struct tree_entry *data;
-	struct line *entry, *line;
+	struct line *entry;
 	enum line_type type;
 	char *path;
-	size_t size;
+
+	if (!buf && !state->read_date) {
+		if (!tree_sort_entries(view, state)) {
+			report("Failed to load tree data");
+			return true;
+		}
+
+		/* Restore the position now that the entries are in place. */
+		view->prev_pos = state->prev_pos;
+	}
+
+	/* Remember the dates unless the history walk was stopped early. */
+	if (!buf && state->read_date &&
+	    (!force_stop || state->annotated == view->lines - tree_first_entry(view)))
+		tree_save_dates(view, state);
 
 	if (state->read_date || !buf)
 		return tree_read_date(view, buf, state);
 
 	if (buf->size <= SIZEOF_TREE_ATTR)
 		return false;
-	if (view->lines == 0 &&
-	    !tree_entry(view, LINE_HEADER, view->env->directory, NULL, NULL, 0))
-		return false;
+	if (view->lines == 0) {
+		/* The position refers to the sorted entries, so keep it
+		 * from being restored until they have been sorted. */
+		state->prev_pos = view->prev_pos;
+		clear_position(&view->prev_pos);
+		if (!tree_entry(view, LINE_HEADER, view->env->directory, NULL, NULL))
+			return false;
+	}
 
-	size = parse_size(buf->data + SIZEOF_TREE_ATTR);
-	path = strchr(buf->data + SIZEOF_TREE_ATTR, '\t');
-	if (!path)
-		return false;
-	path++;
+	path = buf->data + SIZEOF_TREE_ATTR;
 
 	/* Strip the path part ... */
 	if (*view->env->directory) {
@@ -250,39 +458,183 @@ tree_read(struct view *view, struct buffer *buf, bool force_stop)
 
 		/* Insert "link" to parent directory. */
 		if (view->lines == 1 &&
-		    !tree_entry(view, LINE_DIRECTORY, "..", "040000", view->ref, 0))
+		    !tree_entry(view, LINE_DIRECTORY, "..", "040000", view->ref))
 			return false;
 	}
 
+	/* Entries are sorted once all of them have been read. */
 	type = buf->data[SIZEOF_TREE_MODE] == 't' ? LINE_DIRECTORY : LINE_FILE;
-	entry = tree_entry(view, type, path, buf->data, buf->data + TREE_ID_OFFSET, size);
+	entry = tree_entry(view, type, path, buf->data, buf->data + TREE_ID_OFFSET);
 	if (!entry)
 		return false;
-	data = entry->data;
 	view_column_info_update(view, entry);
 
-	/* Skip "Directory ..." and ".." line. */
-	for (line = &view->line[1 + !!*view->env->directory]; line < entry; line++) {
-		if (tree_compare_entry(line, entry) <= 0)
-			continue;
+	/* Move the current line to the first tree entry. */
+	if (!check_position(&state->prev_pos) && !check_position(&view->pos))
+		goto_view_line(view, 0, 1);
 
-		memmove(line + 1, line, (entry - line) * sizeof(*entry));
+	return true;
+}
 
-		line->data = data;
-		line->type = type;
-		line->dirty = line->cleareol = 1;
-		for (line++; line <= entry; line++) {
-			line->dirty = line->cleareol = 1;
-			line->lineno++;
+static bool
+tree_show_file_size(struct view *view)
+{
+	struct view_column *column = get_view_column(view, VIEW_COLUMN_FILE_SIZE);
+
+	return column && !column->hidden &&
+	       column->opt.file_size.display != FILE_SIZE_NO;
+}
+
+/* Find the line of an entry waiting for its size, which may have moved
+ * if the view has been sorted since the size was requested. */
+static struct line *
+tree_size_line(struct view *view, struct tree_size *size)
+{
+	size_t i;
+
+	if (size->lineno < view->lines && view->line[size->lineno].data == size->entry)
+		return &view->line[size->lineno];
+
+	for (i = 0; i < view->lines; i++)
+		if (view->line[i].data == size->entry)
+			return &view->line[i];
+
+	return NULL;
+}
+
+/* Fill in the sizes of entries whose replies have arrived. Returns true
+ * if any line was updated. */
+static bool
+tree_read_sizes(struct view *view, bool can_block)
+{
+	struct tree_state *state = view->private;
+	bool updated = false;
+
+	while (state->sizes_read < state->sizes_count) {
+		unsigned long sizes[256];
+		bool found[ARRAY_SIZE(sizes)];
+		size_t wanted = MIN(ARRAY_SIZE(sizes), state->sizes_count - state->sizes_read);
+		ssize_t count = io_object_sizes_read(sizes, found, wanted, can_block);
+		ssize_t i;
+
+		/* Without replies to come the remaining entries are left
+		 * without a size. */
+		if (count < 0 || (!count && !io_object_sizes_pipe())) {
+			state->sizes_read = state->sizes_count;
+			break;
+		}
+
+		if (!count)
+			break;
+
+		for (i = 0; i < count; i++) {
+			struct tree_size *size = &state->sizes[state->sizes_read++];
+			struct line *line;
+
+			if (!found[i])
+				continue;
+
+			size->entry->size = sizes[i];
+			size->entry->has_size = true;
+			line = tree_size_line(view, size);
+			if (line) {
+				line->dirty = 1;
+				view_column_info_update(view, line);
+				updated = true;
+			}
 		}
-		return true;
 	}
 
-	/* Move the current line to the first tree entry. */
-	if (!check_position(&view->prev_pos) && !check_position(&view->pos))
-		goto_view_line(view, 0, 1);
+	if (state->sizes_read == state->sizes_count) {
+		state->sizes_read = state->sizes_count = 0;
+		view->lookup_pipe = NULL;
+	}
 
-	return true;
+	if (updated)
+		search_cache_drop(view);
+	return updated;
+}
+
+/* Request the sizes of the blobs in the range of lines. Entries which
+ * cannot be requested yet because too many replies are pending are
+ * left to be requested when drawn again. */
+static void
+tree_request_sizes(struct view *view, size_t first, size_t last)
+{
+	struct tree_state *state = view->private;
+	size_t i = first;
+
+	while (i < last) {
+		const char *ids[256];
+		size_t count = 0;
+
+		if (!tree_realloc_sizes(&state->sizes, state->sizes_count, ARRAY_SIZE(ids)))
+			break;
+
+		for (; i < last && count < ARRAY_SIZE(ids); i++) {
+			struct tree_entry *entry = view->line[i].data;
+			struct tree_size *size = &state->sizes[state->sizes_count + count];
+
+			if (view->line[i].type != LINE_FILE || entry->size_checked)
+				continue;
+			if (!S_ISREG(entry->mode) && !S_ISLNK(entry->mode)) {
+				entry->size_checked = true;
+				continue;
+			}
+
+			size->entry = entry;
+			size->lineno = i;
+			ids[count++] = entry->id;
+		}
+
+		if (!count || !io_object_sizes_request(ids, count))
+			break;
+
+		while (count--)
+			state->sizes[state->sizes_count++].entry->size_checked = true;
+	}
+
+	view->lookup_pipe = state->sizes_count ? io_object_sizes_pipe() : NULL;
+}
+
+/* Request the sizes of the blobs on the screen and one screen above and
+ * below it. */
+static void
+tree_load_sizes(struct view *view)
+{
+	size_t first = view->pos.offset > view->height ? view->pos.offset - view->height : 0;
+	size_t last = MIN(view->pos.offset + 2 * view->height, view->lines);
+
+	tree_request_sizes(view, first, last);
+}
+
+/* Sorting by size needs the sizes of all blobs, which are requested in
+ * chunks while reading the replies so that unknown sizes are not sorted
+ * first. */
+static void
+tree_load_all_sizes(struct view *view)
+{
+	size_t i;
+
+	tree_read_sizes(view, true);
+
+	for (i = tree_first_entry(view); i < view->lines; i += 256) {
+		tree_request_sizes(view, i, MIN(i + 256, view->lines));
+		tree_read_sizes(view, true);
+	}
+}
+
+static void
+tree_lookup(struct view *view, bool sorting)
+{
+	if (sorting) {
+		if (get_sort_field(view) == VIEW_COLUMN_FILE_SIZE)
+			tree_load_all_sizes(view);
+		return;
+	}
+
+	if (tree_read_sizes(view, false) && view_is_displayed(view))
+		redraw_view_dirty(view);
 }
 
 static bool
@@ -295,6 +647,9 @@ tree_draw(struct view *view, struct line *line, unsigned int lineno)
 		return true;
 	}
 
+	if (line->type == LINE_FILE && !entry->size_checked && tree_show_file_size(view))
+		tree_load_sizes(view);
+
 	return view_column_draw(view, line, lineno);
 }
 
@@ -431,7 +786,7 @@ static enum status_code
 tree_open(struct view *view, enum open_flags flags)
 {
 	static const char *tree_argv[] = {
-		"git", "ls-tree", "-l", "%(commit)", "--", "%(directory)", NULL
+		"git", "ls-tree", "%(commit)", "--", "%(directory)", NULL
 	};
 
 	if (string_rev_is_null(view->env->commit))
@@ -460,6 +815,31 @@ tree_open(struct view *view, enum open_flags flags)
 	return begin_update(view, repo.cdup, tree_argv, flags);
 }
 
+/* Replies to pending size requests are read and discarded so they are
+ * not mistaken for replies to later requests. */
+static void
+tree_done(struct view *view)
+{
+	struct tree_state *state = view->private;
+
+	while (state->sizes_read < state->sizes_count) {
+		unsigned long sizes[256];
+		bool found[ARRAY_SIZE(sizes)];
+		size_t wanted = MIN(ARRAY_SIZE(sizes), state->sizes_count - state->sizes_read);
+		ssize_t count = io_object_sizes_read(sizes, found, wanted, true);
+
+		if (count <= 0)
+			break;
+		state->sizes_read += count;
+	}
+
+	free(state->sizes);
+	state->sizes = NULL;
+	state->sizes_read = state->sizes_count = 0;
+	view->lookup_pipe = NULL;
+	string_map_free(&state->entries);
+}
+
 static struct view_ops tree_ops = {
 	"file",
 	argv_env.commit,
@@ -471,12 +851,13 @@ static struct view_ops tree_ops = {
 	tree_request,
 	view_column_grep,
 	tree_select,
-	NULL,
+	tree_done,
 	view_column_bit(AUTHOR) | view_column_bit(DATE) |
 		view_column_bit(FILE_NAME) | view_column_bit(FILE_SIZE) |
 		view_column_bit(ID) | view_column_bit(LINE_NUMBER) |
 		view_column_bit(MODE),
 	tree_get_column_data,
+	tree_lookup,
 };
 
 DEFINE_VIEW(tree);
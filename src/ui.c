@@ -24,7 +24,7 @@ struct file_finder_line {
 	char text[1];
 };
 
-DEFINE_ALLOCATOR(realloc_file_array, struct file_finder_line *, 256)
+DEFINE_GEOMETRIC_ALLOCATOR(realloc_file_array, struct file_finder_line *, 256)
 
 struct file_finder {
 	WINDOW *win;
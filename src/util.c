@@ -180,7 +180,7 @@ get_relative_date(const struct time *time, char *buf, size_t buflen, bool compac
 const char *
 mkdate(const struct time *time, enum date date, bool local, const char *custom_format)
 {
-	static char buf[SIZEOF_STR];
+	static THREAD_LOCAL char buf[SIZEOF_STR];
 	struct tm tm;
 	const char *format;
 
@@ -208,7 +208,7 @@ mkdate(const struct time *time, enum date date, bool local, const char *custom_f
 const char *
 mkfilesize(unsigned long size, enum file_size format)
 {
-	static char buf[64 + 1];
+	static THREAD_LOCAL char buf[64 + 1];
 	static const char relsize[] = {
 		'B', 'K', 'M', 'G', 'T', 'P'
 	};
@@ -258,7 +258,7 @@ ident_compare(const struct ident *i1, const struct ident *i2)
 static const char *
 get_author_initials(const char *author)
 {
-	static char initials[256];
+	static THREAD_LOCAL char initials[256];
 	size_t pos = 0;
 	const char *end = strchr(author, '\0');
 
@@ -301,7 +301,7 @@ get_author_initials(const char *author)
 static const char *
 get_email_user(const char *email)
 {
-	static char user[SIZEOF_STR + 1];
+	static THREAD_LOCAL char user[SIZEOF_STR + 1];
 	const char *end = strchr(email, '@');
 	int length = end ? end - email : strlen(email);
 
@@ -346,7 +346,7 @@ mkmode(mode_t mode)
 const char *
 mkstatus(const char status, enum status_label label)
 {
-	static char default_label[] = { '?', 0 };
+	static THREAD_LOCAL char default_label[] = { '?', 0 };
 	static const char *labels[][2] = {
 		{ "!", "ignored" },
 		{ "?", "untracked" },
@@ -379,29 +379,156 @@ mkstatus(const char status, enum status_label label)
  * Allocation helper.
  */
 
+static void *
+resize_allocation(void *mem, size_t type_size, size_t old_count, size_t new_count)
+{
+	size_t newsize = new_count * type_size;
+	void *tmp = realloc(mem, newsize);
+
+	if (!tmp)
+		return NULL;
+
+	if (new_count > old_count) {
+		size_t oldsize = old_count * type_size;
+
+		memset(tmp + oldsize, 0, newsize - oldsize);
+	}
+
+	return tmp;
+}
+
 void *
 chunk_allocator(void *mem, size_t type_size, size_t chunk_size, size_t size, size_t increase)
 {
 	size_t num_chunks = (size + chunk_size - 1) / chunk_size;
 	size_t num_chunks_new = (size + increase + chunk_size - 1) / chunk_size;
 
-	if (mem == NULL || num_chunks != num_chunks_new) {
-		size_t newsize = num_chunks_new * chunk_size * type_size;
-		void *tmp = realloc(mem, newsize);
+	if (mem == NULL || num_chunks != num_chunks_new)
+		return resize_allocation(mem, type_size, num_chunks * chunk_size,
+					 num_chunks_new * chunk_size);
 
-		if (!tmp)
-			return NULL;
+	return mem;
+}
+
+/* The capacity is derived from the current size so callers do not have to
+ * keep track of it: min_size times the smallest power of two that fits all
+ * elements. */
+static size_t
+geometric_capacity(size_t min_size, size_t size)
+{
+	size_t chunks = (size + min_size - 1) / min_size;
+	int shift;
+
+	if (chunks <= 1)
+		return chunks * min_size;
+
+	/* Round up to the next power of two. */
+	chunks--;
+	for (shift = 1; shift < sizeof(chunks) * 8; shift <<= 1)
+		chunks |= chunks >> shift;
+
+	return (chunks + 1) * min_size;
+}
+
+void *
+geometric_allocator(void *mem, size_t type_size, size_t min_size, size_t size, size_t increase)
+{
+	size_t capacity = geometric_capacity(min_size, size);
+	size_t capacity_new = geometric_capacity(min_size, size + increase);
+
+	if (mem == NULL || capacity != capacity_new)
+		return resize_allocation(mem, type_size, capacity, capacity_new);
+
+	return mem;
+}
+
+/*
+ * Arena allocator.
+ */
 
-		if (num_chunks_new > num_chunks) {
-			size_t oldsize = num_chunks * chunk_size * type_size;
+#define ARENA_SLAB_SIZE		(256 * 1024)
 
-			memset(tmp + oldsize, 0, newsize - oldsize);
+union arena_align {
+	void *ptr;
+	long num;
+	double real;
+};
+
+#define ARENA_ALIGN		sizeof(union arena_align)
+#define arena_align(size)	(((size) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+struct arena_slab {
+	struct arena_slab *prev;
+	size_t used;
+	size_t size;
+	union arena_align data[1];
+};
+
+static struct arena_slab *
+arena_slab_new(struct arena *arena, size_t size)
+{
+	struct arena_slab *slab = calloc(1, sizeof(*slab) + size);
+
+	if (!slab)
+		return NULL;
+
+	slab->size = size;
+	arena->slabs++;
+	return slab;
+}
+
+void *
+arena_alloc(struct arena *arena, size_t size)
+{
+	struct arena_slab *slab = arena->slab;
+	void *mem;
+
+	size = arena_align(size);
+
+	/* Large allocations get a slab of their own, which is put behind
+	 * the current slab so its remaining space can still be used. */
+	if (size > ARENA_SLAB_SIZE / 4) {
+		struct arena_slab *big = arena_slab_new(arena, size);
+
+		if (!big)
+			return NULL;
+
+		if (slab) {
+			big->prev = slab->prev;
+			slab->prev = big;
+		} else {
+			arena->slab = big;
 		}
+		slab = big;
 
-		return tmp;
+	} else if (!slab || slab->size - slab->used < size) {
+		slab = arena_slab_new(arena, ARENA_SLAB_SIZE);
+		if (!slab)
+			return NULL;
+		slab->prev = arena->slab;
+		arena->slab = slab;
 	}
 
+	mem = (char *) slab->data + slab->used;
+	slab->used += size;
+	arena->allocs++;
+	arena->size += size;
 	return mem;
 }
 
+void
+arena_free(struct arena *arena)
+{
+	struct arena_slab *slab = arena->slab;
+
+	while (slab) {
+		struct arena_slab *prev = slab->prev;
+
+		free(slab);
+		slab = prev;
+	}
+
+	memset(arena, 0, sizeof(*arena));
+}
+
 /* vim: set ts=8 sw=8 noexpandtab: */
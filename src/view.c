@@ -89,7 +89,10 @@ do_scroll_view(struct view *view, int lines)
 
 		if (redraw_current_line)
 			draw_view_line(view, view->pos.lineno - view->pos.offset);
-		wnoutrefresh(view->win);
+		if (view->force_redraw)
+			redraw_view(view);
+		else
+			wnoutrefresh(view->win);
 	}
 
 	view->has_scrolled = true;
@@ -256,7 +259,8 @@ move_view(struct view *view, enum request request)
 	if (!view_is_displayed(view)) {
 		view->pos.offset += scroll_steps;
 		assert(0 <= view->pos.offset && view->pos.offset < view->lines);
-		view->ops->select(view, &view->line[view->pos.lineno]);
+		if (view->ops->select)
+			view->ops->select(view, &view->line[view->pos.lineno]);
 		return;
 	}
 
@@ -290,18 +294,140 @@ select_view_line(struct view *view, unsigned long lineno)
 				draw_view_line(view, view->pos.lineno - view->pos.offset);
 				wnoutrefresh(view->win);
 			}
-		} else {
+		} else if (view->ops->select) {
 			view->ops->select(view, &view->line[view->pos.lineno]);
 		}
 	}
 }
 
+/*
+ * Index of lines by commit ID. Entries are keyed by the ID prefix so
+ * abbreviated IDs can be looked up as long as they are at least
+ * VIEW_ID_PREFIX characters long. The index only supports views
+ * appending lines as they are read.
+ */
+
+#define VIEW_ID_PREFIX	8
+
+struct view_id {
+	struct view_id *next;	/* Next line with the same ID prefix. */
+	unsigned long lineno;
+	char prefix[VIEW_ID_PREFIX + 1];
+};
+
+static const char *
+view_id_key(const void *value)
+{
+	return ((const struct view_id *) value)->prefix;
+}
+
+static string_map_key_t
+view_id_hash(const void *value)
+{
+	return string_map_hash_helper(view_id_key(value));
+}
+
+bool
+view_add_id(struct view *view, const char *id, unsigned long lineno)
+{
+	struct view_id *entry;
+	void **slot;
+
+	if (strlen(id) < VIEW_ID_PREFIX)
+		return true;
+
+	if (!view->ids.key_fn) {
+		view->ids.hash_fn = view_id_hash;
+		view->ids.key_fn = view_id_key;
+	}
+
+	entry = arena_alloc(&view->arena, sizeof(*entry));
+	if (!entry)
+		return false;
+	string_ncopy(entry->prefix, id, VIEW_ID_PREFIX);
+	entry->lineno = lineno;
+
+	slot = string_map_put_to(&view->ids, entry->prefix);
+	if (!slot)
+		return false;
+	entry->next = *slot;
+	*slot = entry;
+	return true;
+}
+
+static bool
+view_line_has_id(struct view *view, struct line *line, const char *id, size_t idlen)
+{
+	struct view_column_data column_data = {0};
+
+	return view->ops->get_column_data(view, line, &column_data) &&
+	       column_data.id &&
+	       !strncasecmp(column_data.id, id, idlen);
+}
+
+/* Find the first line from @lineno with the given ID. */
+static struct line *
+view_find_id(struct view *view, const char *id, unsigned long lineno)
+{
+	size_t idlen = strlen(id);
+	struct line *found = NULL;
+	struct line *line;
+
+	if (view->ids.htab && idlen >= VIEW_ID_PREFIX) {
+		char prefix[VIEW_ID_PREFIX + 1];
+		struct view_id *entry;
+
+		string_ncopy(prefix, id, VIEW_ID_PREFIX);
+		for (entry = string_map_get(&view->ids, prefix); entry; entry = entry->next) {
+			line = &view->line[entry->lineno];
+			if (lineno <= entry->lineno && entry->lineno < view->lines &&
+			    (!found || line < found) &&
+			    view_line_has_id(view, line, id, idlen))
+				found = line;
+		}
+
+		return found;
+	}
+
+	for (line = &view->line[lineno]; view_has_line(view, line); line++)
+		if (view_line_has_id(view, line, id, idlen))
+			return line;
+
+	return NULL;
+}
+
+/* Select the line with the pending ID or, while the view is still
+ * loading, report how far the search has come. */
+static void
+view_goto_pending(struct view *view)
+{
+	struct view_goto *pending = &view->goto_pending;
+	struct line *line = view_find_id(view, pending->id, pending->lineno);
+
+	if (line) {
+		if (pending->save_search)
+			string_ncopy(view->env->search, pending->id, strlen(pending->id));
+		select_view_line(view, line - view->line);
+		report_clear();
+
+	} else if (view->pipe) {
+		pending->lineno = view->lines;
+		report("Loading until commit '%s' is found (%zu lines)", pending->id, view->lines);
+		return;
+
+	} else {
+		report("Unable to find commit '%s'", pending->id);
+	}
+
+	pending->id[0] = 0;
+}
+
 void
 goto_id(struct view *view, const char *expr, bool from_start, bool save_search)
 {
 	struct view_column_data column_data = {0};
+	struct view_goto *pending = &view->goto_pending;
 	char id[SIZEOF_STR] = "";
-	size_t idlen;
 	struct line *line = &view->line[view->pos.lineno];
 
 	if (!(view->ops->column_bits & view_column_bit(ID))) {
@@ -332,23 +458,10 @@ goto_id(struct view *view, const char *expr, bool from_start, bool save_search)
 		return;
 	}
 
-	line = from_start ? view->line : &view->line[view->pos.lineno];
-
-	for (idlen = strlen(id); view_has_line(view, line); line++) {
-		struct view_column_data column_data = {0};
-
-		if (view->ops->get_column_data(view, line, &column_data) &&
-		    column_data.id &&
-		    !strncasecmp(column_data.id, id, idlen)) {
-			if (save_search)
-				string_ncopy(view->env->search, id, idlen);
-			select_view_line(view, line - view->line);
-			report_clear();
-			return;
-		}
-	}
-
-	report("Unable to find commit '%s'", id);
+	string_ncopy(pending->id, id, strlen(id));
+	pending->lineno = from_start ? 0 : view->pos.lineno;
+	pending->save_search = save_search;
+	view_goto_pending(view);
 }
 
 /*
@@ -418,10 +531,7 @@ reset_view_history(struct view_history *history)
 void
 reset_view(struct view *view)
 {
-	int i;
-
-	for (i = 0; i < view->lines; i++)
-		free(view->line[i].data);
+	arena_free(&view->arena);
 	free(view->line);
 
 	reset_search(view);
@@ -439,6 +549,10 @@ reset_view(struct view *view)
 	view->vid[0] = 0;
 	view->custom_lines = 0;
 	view->update_secs = 0;
+	view->goto_pending.id[0] = 0;
+	string_map_clear(&view->ids);
+	view->stats.bytes = 0;
+	view->stats.allocs = 0;
 }
 
 static bool
@@ -478,6 +592,10 @@ end_update(struct view *view, bool force)
 		io_kill(view->pipe);
 	io_done(view->pipe);
 	view->pipe = NULL;
+	view->stats.load_time = io_trace_clock() - view->stats.load_start;
+
+	if (*view->goto_pending.id)
+		view_goto_pending(view);
 }
 
 static void
@@ -488,6 +606,11 @@ setup_update(struct view *view, const char *vid)
 	string_ncopy(view->vid, vid, strlen(vid));
 	view->pipe = &view->io;
 	view->start_time = time(NULL);
+	view->stats.loads++;
+	view->stats.load_start = io_trace_clock();
+	view->stats.load_time = 0;
+	view->stats.read_time = 0;
+	view->stats.parse_time = 0;
 }
 
 static bool
@@ -528,7 +651,11 @@ view_exec(struct view *view, enum open_flags flags)
 	string_format(opt_env_columns, "COLUMNS=%d", MAX(0, width));
 	string_format(opt_env_lines, "LINES=%d", height);
 
-	return io_exec(&view->io, IO_RD, view->dir, opt_env, view->argv, io_flags);
+	if (!io_exec(&view->io, IO_RD, view->dir, opt_env, view->argv, io_flags))
+		return false;
+	io_trace_owner(&view->io, view->name);
+	view->stats.commands++;
+	return true;
 }
 
 enum status_code
@@ -581,10 +708,16 @@ update_view(struct view *view)
 	bool can_read = true;
 	struct encoding *encoding = view->encoding ? view->encoding : default_encoding;
 	struct buffer line;
+	bool tracing;
+	double start = 0, mark = 0, read_time = 0, parse_time = 0;
+	unsigned long lines = 0;
 
 	if (!view->pipe)
 		return true;
 
+	if (encoding && view->pipe->encoding != encoding)
+		io_set_encoding(view->pipe, encoding);
+
 	if (!io_can_read(view->pipe, false)) {
 		if (view->lines == 0 && view_is_displayed(view)) {
 			time_t secs = time(NULL) - view->start_time;
@@ -599,18 +732,43 @@ update_view(struct view *view)
 		return true;
 	}
 
+	/* Split the time spent reading and parsing lines for the stats view.
+	 * When tracing, each update is also reported as a read span and a
+	 * parse span. */
+	tracing = io_trace_spans();
+	start = mark = io_trace_clock();
+
 	for (; io_get(view->pipe, &line, '\n', can_read); can_read = false) {
-		if (encoding && !encoding_convert(encoding, &line)) {
-			report("Encoding failure");
-			end_update(view, true);
-			return false;
-		}
+		double now = io_trace_clock();
+
+		read_time += now - mark;
+		mark = now;
 
 		if (!view->ops->read(view, &line, false)) {
 			report("Allocation failure");
 			end_update(view, true);
 			return false;
 		}
+
+		now = io_trace_clock();
+		parse_time += now - mark;
+		mark = now;
+		lines++;
+	}
+
+	/* The last io_get() found no complete line but may have read. */
+	read_time += io_trace_clock() - mark;
+	view->stats.read_time += read_time;
+	view->stats.parse_time += parse_time;
+
+	if (*view->goto_pending.id && view->pipe)
+		view_goto_pending(view);
+
+	if (tracing) {
+		io_trace_span("read", start, start + read_time,
+			      "\"view\":\"%s\"", view->name);
+		io_trace_span("parse", start + read_time, start + read_time + parse_time,
+			      "\"view\":\"%s\",\"lines\":%lu", view->name, lines);
 	}
 
 	if (io_error(view->pipe)) {
@@ -627,6 +785,9 @@ update_view(struct view *view)
 	if (!view_is_displayed(view))
 		return true;
 
+	if (tracing)
+		start = io_trace_clock();
+
 	if (redraw || view->force_redraw)
 		redraw_view_from(view, 0);
 	else
@@ -636,6 +797,11 @@ update_view(struct view *view)
 	/* Update the title _after_ the redraw so that if the redraw picks up a
 	 * commit reference in view->ref it'll be available here. */
 	update_view_title(view);
+
+	if (tracing)
+		io_trace_span("redraw", start, io_trace_clock(),
+			      "\"view\":\"%s\",\"full\":%s", view->name,
+			      redraw ? "true" : "false");
 	return true;
 }
 
@@ -956,6 +1122,11 @@ sort_view_compare(const void *l1, const void *l2)
 void
 resort_view(struct view *view, bool renumber)
 {
+	if (view->ops->lookup)
+		view->ops->lookup(view, true);
+
+	/* Cached searches refer to lines by their position. */
+	search_cache_drop(view);
 	sorting_view = view;
 	qsort(view->line, view->lines, sizeof(*view->line), sort_view_compare);
 
@@ -1059,10 +1230,10 @@ view_column_text(struct view *view, struct view_column_data *column_data,
 static bool
 grep_refs(struct view *view, struct view_column *column, const struct ref *ref)
 {
-	regmatch_t pmatch;
-
 	for (; ref; ref = ref->next) {
-		if (!regexec(view->regex, ref->name, 1, &pmatch, 0))
+		const char *text[] = { ref->name, NULL };
+
+		if (grep_text(view, text))
 			return true;
 	}
 
@@ -1123,6 +1294,9 @@ view_column_reset(struct view *view)
 	view_column_info_changed(view, true);
 	for (column = view->columns; column; column = column->next)
 		column->width = 0;
+
+	/* Cached searches matched the text of the old column options. */
+	search_cache_drop(view);
 }
 
 static enum status_code
@@ -1523,7 +1697,7 @@ find_line_by_type(struct view *view, struct line *line, enum line_type type, int
  * Line utilities.
  */
 
-DEFINE_ALLOCATOR(realloc_lines, struct line, 256)
+DEFINE_GEOMETRIC_ALLOCATOR(realloc_lines, struct line, 256)
 
 static inline char *
 box_text_offset(struct box *box, size_t cells)
@@ -1550,10 +1724,12 @@ add_line_at(struct view *view, unsigned long pos, const void *data, enum line_ty
 		return NULL;
 
 	if (data_size) {
-		void *alloc_data = calloc(1, data_size);
+		void *alloc_data = arena_alloc(&view->arena, data_size);
 
 		if (!alloc_data)
 			return NULL;
+		view->stats.bytes += data_size;
+		view->stats.allocs++;
 
 		if (data)
 			memcpy(alloc_data, data, data_size);
@@ -1656,6 +1832,7 @@ append_line_format(struct view *view, struct line *line, const char *fmt, ...)
 {
 	struct box *box = line->data;
 	size_t textlen = box_text_length(box);
+	size_t boxsize = box_sizeof(box, 0, 0);
 	int fmtlen, retval;
 	va_list args;
 	char *text;
@@ -1667,9 +1844,11 @@ append_line_format(struct view *view, struct line *line, const char *fmt, ...)
 	if (fmtlen <= 0)
 		return false;
 
-	box = realloc(box, box_sizeof(box, 0, fmtlen));
+	/* The old box stays in the arena until the view is reset. */
+	box = arena_alloc(&view->arena, box_sizeof(box, 0, fmtlen));
 	if (!box)
 		return false;
+	memcpy(box, line->data, boxsize);
 
 	box->text = text = box_text_offset(box, box->cells);
 	FORMAT_BUFFER(text + textlen, fmtlen + 1, fmt, retval, false);
@@ -1704,6 +1883,7 @@ append_line_format(struct view *view, struct line *line, const char *fmt, ...)
 #include "tig/grep.h"
 #include "tig/pager.h"
 #include "tig/help.h"
+#include "tig/stats.h"
 
 static struct view *views[] = {
 #define VIEW_DATA(id, name) &name##_view